@@ -0,0 +1,169 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#define NOMINMAX
+#include <Windows.h>
+
+#include <d3d11.h>
+#include <dxgi1_2.h>
+#include <wrl/client.h>
+
+#include "error.h"
+#include "source.h"
+#include "tool.h"
+
+namespace capture
+{
+
+// Frames of the desktop from IDXGIOutputDuplication. They stay on the GPU,
+// so this source hands out textures instead of pixels.
+class duplication final : public frame_source
+{
+public:
+    duplication(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<IDXGIOutput1> output)
+        : device(std::move(device))
+        , output(std::move(output))
+    {
+        using namespace aux;
+        this->output->DuplicateOutput(this->device.Get(), &session) >> must::succeed;
+    }
+
+    auto acquire(std::chrono::milliseconds timeout = {}) -> bool override
+    {
+        using namespace aux;
+
+        auto hr             = S_OK;
+        auto frame_info     = DXGI_OUTDUPL_FRAME_INFO{};
+        auto frame_resource = Microsoft::WRL::ComPtr<IDXGIResource>{};
+        auto wait           = static_cast<UINT>(timeout.count());
+
+        if (hr = session->AcquireNextFrame(wait, &frame_info, &frame_resource); hr == DXGI_ERROR_ACCESS_LOST)
+        {
+            // Retry AcquireNextFrame once
+            output->DuplicateOutput(device.Get(), &session) >> must::succeed;
+            hr = session->AcquireNextFrame(wait, &frame_info, &frame_resource);
+        }
+
+        if (FAILED(hr) && hr != DXGI_ERROR_WAIT_TIMEOUT)
+        {
+            hr >> must::succeed;
+        }
+        else if (hr == DXGI_ERROR_WAIT_TIMEOUT || frame_info.LastPresentTime.QuadPart == 0)
+        {
+            // Zero LastPresentTime means there is nothing changed, no need to update.
+            //
+            // Refer to
+            // https://learn.microsoft.com/en-us/windows/win32/api/dxgi1_2/ns-dxgi1_2-dxgi_outdupl_frame_info#members
+            return false;
+        }
+
+        frame_resource.As(&screenshot) >> must::succeed;
+
+        auto desc = D3D11_TEXTURE2D_DESC{};
+        screenshot->GetDesc(&desc);
+        status.width  = desc.Width;
+        status.height = desc.Height;
+        status.format = pixel_format::bgra8;
+        status.index += 1;
+        collect_dirty(frame_info);
+        return true;
+    }
+
+    auto release() -> void override
+    {
+        using namespace aux;
+
+        // Note:
+        //
+        // > For performance reasons, we recommend that you release the frame
+        // > just before you call the IDXGIOutputDuplication::AcquireNextFrame
+        // > method to acquire the next frame.
+        //
+        // Refer to
+        // https://learn.microsoft.com/en-us/windows/win32/api/dxgi1_2/nf-dxgi1_2-idxgioutputduplication-releaseframe
+
+        screenshot.Reset();
+        switch (auto hr = session->ReleaseFrame(); hr)
+        {
+        case DXGI_ERROR_ACCESS_LOST:
+            // Need to create a new DuplicateOutput
+            //
+            // Refer to
+            // https://learn.microsoft.com/en-us/windows/win32/api/dxgi1_2/nn-dxgi1_2-idxgioutputduplication
+            // https://stackoverflow.com/a/31238973
+            output->DuplicateOutput(device.Get(), &session) >> must::succeed;
+            break;
+
+        case DXGI_ERROR_INVALID_CALL:
+            // Already released, so ignore it
+            break;
+
+        default:
+            hr >> must::succeed;
+            break;
+        }
+    }
+
+    auto info() const -> frame_info const & override
+    {
+        return status;
+    }
+
+    // The desktop image of the current frame, valid until "release".
+    auto texture() const -> Microsoft::WRL::ComPtr<ID3D11Texture2D> const &
+    {
+        return screenshot;
+    }
+
+private:
+    // Dirty rects plus the destinations of move rects.
+    //
+    // Refer to
+    // https://learn.microsoft.com/en-us/windows/win32/direct3ddxgi/desktop-dup-api#updating-the-desktop-image-data
+    auto collect_dirty(DXGI_OUTDUPL_FRAME_INFO const & frame_info) -> void
+    {
+        auto const to_rect = [this](RECT const & r)
+        {
+            auto clamp = [](LONG v, UINT limit)
+            { return static_cast<std::uint32_t>(std::clamp(v, LONG{}, static_cast<LONG>(limit))); };
+            return image::rect{
+                clamp(r.left, status.width), clamp(r.top, status.height), clamp(r.right, status.width),
+                clamp(r.bottom, status.height)
+            };
+        };
+
+        status.dirty.clear();
+        if (frame_info.TotalMetadataBufferSize == 0)
+            return whole(status);
+
+        metadata.resize(frame_info.TotalMetadataBufferSize);
+
+        auto used  = UINT{};
+        auto moves = reinterpret_cast<DXGI_OUTDUPL_MOVE_RECT *>(metadata.data());
+        if (FAILED(session->GetFrameMoveRects(static_cast<UINT>(metadata.size()), moves, &used)))
+            return whole(status);
+
+        for (auto i = UINT{}; i < used / sizeof(DXGI_OUTDUPL_MOVE_RECT); ++i)
+            status.dirty.push_back(to_rect(moves[i].DestinationRect));
+
+        auto rects = reinterpret_cast<RECT *>(metadata.data());
+        if (FAILED(session->GetFrameDirtyRects(static_cast<UINT>(metadata.size()), rects, &used)))
+            return whole(status);
+
+        for (auto i = UINT{}; i < used / sizeof(RECT); ++i)
+            status.dirty.push_back(to_rect(rects[i]));
+    }
+
+private:
+    Microsoft::WRL::ComPtr<ID3D11Device>           device;
+    Microsoft::WRL::ComPtr<IDXGIOutput1>           output;
+    Microsoft::WRL::ComPtr<IDXGIOutputDuplication> session{};
+    Microsoft::WRL::ComPtr<ID3D11Texture2D>        screenshot{};
+    std::vector<std::byte>                         metadata{};
+    frame_info                                     status{};
+};
+} // namespace capture
@@ -1,4 +1,5 @@
 SamplerState screenshot_sampler : register(s0);
+SamplerState nearest_sampler : register(s1);
 Texture2D screenshot : register(t0);
 
 // Note: about "gourp"
@@ -8,6 +9,14 @@ cbuffer triangle_group : register(b0)
     float2 const origin;
     float  const length;
     float  const height;
+
+    // Where the screenshot lies in the texture: all of it, or a patch of
+    // it around the triangle (see "update_patch" in render.cc)
+    float2 const patch_scale;
+    float2 const patch_origin;
+
+    // Non-zero: take the nearest texel instead of blending four
+    float  const nearest;
 };
 
 float cross2(float2 a, float2 b)
@@ -95,5 +104,10 @@ float4 main(float2 o : TEXCOORD) : SV_TARGET
         o = reflect(o, right, right_to_top, 0.5 * right_to_top - left_to_top);
     }
 
-    return screenshot.Sample(screenshot_sampler, o);
+    float2 const uv = o * patch_scale - patch_origin;
+    if (nearest != 0)
+    {
+        return screenshot.Sample(nearest_sampler, uv);
+    }
+    return screenshot.Sample(screenshot_sampler, uv);
 }
@@ -1,7 +1,12 @@
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <concepts>
+#include <cstdint>
+#include <span>
 #include <stdexcept>
 #include <system_error>
+#include <vector>
 
 #define NOMINMAX
 #include <Windows.h>
@@ -13,8 +18,11 @@
 #include <dxgi1_6.h>
 #include <wrl/client.h>
 
+#include "duplication.h"
 #include "error.h"
+#include "patch.h"
 #include "render.h"
+#include "schedule.h"
 #include "tool.h"
 
 // Run "build" to generate header files listed in compiled_shader.
@@ -327,7 +335,7 @@ public:
             make::inferenced_output(window, adapter, output) >> must::succeed;
 
             // Create an IDXGIDuplicateOutput
-            output->DuplicateOutput(device11.Get(), &output_duplication) >> must::succeed;
+            screen = std::make_unique<capture::duplication>(device11, output);
         }
 
         /////////////////////////////////////////////////////////////////////
@@ -344,7 +352,7 @@ public:
             // Refer to
             // https://www.3dgep.com/learning-directx-12-4/#Texture_Sampler
             // https://github.com/microsoft/DirectX-Graphics-Samples/blob/a79e01c4c39e6d40f4b078688ff95814d166d34f/Samples/Desktop/D3D12HelloWorld/src/HelloTexture/D3D12HelloTexture.cpp#L165-L178
-            auto samplers                = std::array<D3D12_STATIC_SAMPLER_DESC, 1>{};
+            auto samplers                = std::array<D3D12_STATIC_SAMPLER_DESC, 2>{};
             samplers[0].Filter           = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
             samplers[0].AddressU         = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
             samplers[0].AddressV         = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
@@ -359,6 +367,11 @@ public:
             samplers[0].RegisterSpace    = 0;
             samplers[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 
+            // The same with point filtering, for "on_nearest"
+            samplers[1]                = samplers[0];
+            samplers[1].Filter         = D3D12_FILTER_MIN_MAG_MIP_POINT;
+            samplers[1].ShaderRegister = 1;
+
             // Prepare ranges to maintain descriptors of CBV, SRV and UAV
             auto ranges = std::array<D3D12_DESCRIPTOR_RANGE1, 2>{};
             {
@@ -692,79 +705,266 @@ public:
     auto update_screenshot() -> void
     {
         using namespace aux;
-        using wrl::ComPtr;
 
-        // Note:
-        //
-        // > For performance reasons, we recommend that you release the frame
-        // > just before you call the IDXGIOutputDuplication::AcquireNextFrame
-        // > method to acquire the next frame.
-        //
-        // Refer to
-        // https://learn.microsoft.com/en-us/windows/win32/api/dxgi1_2/nf-dxgi1_2-idxgioutputduplication-releaseframe
+        // Release the previous frame right before acquiring the next one
+        screen->release();
+        auto const is_fresh = screen->acquire();
+        if (is_fresh)
+            schedule.on_capture(screen->info());
+
+        if (is_cropping)
+            return update_patch(is_fresh);
+
+        if (!is_fresh)
+            return;
+
+        auto const & screenshot = screen->texture();
 
-        switch (auto hr = output_duplication->ReleaseFrame(); hr)
+        // Maybe resize
+        auto source = D3D11_TEXTURE2D_DESC{};
+        screenshot->GetDesc(&source);
+        auto target = D3D11_TEXTURE2D_DESC{};
+        shared_texture->GetDesc(&target);
+        if (source.Width != target.Width || source.Height != target.Height)
         {
-        case DXGI_ERROR_ACCESS_LOST:
-            // Need to create a new DuplicateOutput
-            //
-            // Refer to
-            // https://learn.microsoft.com/en-us/windows/win32/api/dxgi1_2/nn-dxgi1_2-idxgioutputduplication
-            // https://stackoverflow.com/a/31238973
-            output->DuplicateOutput(device11.Get(), &output_duplication) >> must::succeed;
-            break;
-
-        case DXGI_ERROR_INVALID_CALL:
-            // Already released, so ignore it
-            break;
-
-        default:
-            hr >> must::succeed;
-            break;
+            make::shared_texture2d(
+                device11, device, descriptor_heap, descriptor_heap_offsets[1], shared_texture, screenshot_texture,
+                shared_texture_handle, source.Width, source.Height
+            ) >> must::succeed;
+            is_screenshot_stale = true;
         }
 
-        auto hr             = S_OK;
-        auto frame_info     = DXGI_OUTDUPL_FRAME_INFO{};
-        auto frame_resource = ComPtr<IDXGIResource>{};
+        // Copy, only the dirty rects if the shared texture holds the previous frame
+        if (is_screenshot_stale)
+        {
+            context11->CopyResource(shared_texture.Get(), screenshot.Get());
+            is_screenshot_stale = false;
+            return;
+        }
 
-        if (hr = output_duplication->AcquireNextFrame(0, &frame_info, &frame_resource); hr == DXGI_ERROR_ACCESS_LOST)
+        for (auto const & r : screen->info().dirty)
         {
-            // Retry AcquireNextFrame once
-            output->DuplicateOutput(device11.Get(), &output_duplication) >> must::succeed;
-            hr = output_duplication->AcquireNextFrame(0, &frame_info, &frame_resource);
+            if (r.empty())
+                continue;
+
+            auto box = D3D11_BOX{r.left, r.top, 0, r.right, r.bottom, 1};
+            context11->CopySubresourceRegion(shared_texture.Get(), 0, r.left, r.top, 0, screenshot.Get(), 0, &box);
         }
+    }
 
-        if (FAILED(hr) && hr != DXGI_ERROR_WAIT_TIMEOUT)
+    // Crop capture
+    //
+    // The fold only reads the triangle's bounding box, so "shared_texture"
+    // only holds that patch. A duplicated frame is gone once released while
+    // the triangle may still move over a still desktop, so the whole desktop
+    // is kept in "desktop_texture", updated by dirty rects on the D3D11 side.
+    //
+    // That is as much D3D11 copying as without cropping, plus the copies into
+    // the patch. What shrinks is the texture shared with D3D12 and read by
+    // the pixel shader, so this is off by default.
+    auto update_patch(bool is_fresh) -> void
+    {
+        using namespace aux;
+
+        auto dirty = std::span<image::rect const>{};
+        if (is_fresh)
         {
-            hr >> must::succeed;
+            auto const & screenshot = screen->texture();
+            auto const & info       = screen->info();
+            if (!desktop_texture || info.width != desktop_width || info.height != desktop_height)
+            {
+                auto desc = D3D11_TEXTURE2D_DESC{};
+                screenshot->GetDesc(&desc);
+                desc.Usage          = D3D11_USAGE_DEFAULT;
+                desc.BindFlags      = 0;
+                desc.CPUAccessFlags = 0;
+                desc.MiscFlags      = 0;
+                device11->CreateTexture2D(&desc, nullptr, &desktop_texture) >> must::succeed;
+                context11->CopyResource(desktop_texture.Get(), screenshot.Get());
+                desktop_width  = info.width;
+                desktop_height = info.height;
+                is_patch_stale = true;
+            }
+            else
+            {
+                for (auto const & r : info.dirty)
+                {
+                    if (r.empty())
+                        continue;
+
+                    auto box = D3D11_BOX{r.left, r.top, 0, r.right, r.bottom, 1};
+                    context11->CopySubresourceRegion(
+                        desktop_texture.Get(), 0, r.left, r.top, 0, screenshot.Get(), 0, &box
+                    );
+                }
+                dirty = info.dirty;
+            }
         }
-        else if (hr == DXGI_ERROR_WAIT_TIMEOUT || frame_info.LastPresentTime.QuadPart == 0)
+
+        if (!desktop_texture)
+            return;
+
+        if (is_patch_stale)
         {
-            // Zero LastPresentTime means there is nothing changed, no need to update.
-            //
-            // Refer to
-            // https://learn.microsoft.com/en-us/windows/win32/api/dxgi1_2/ns-dxgi1_2-dxgi_outdupl_frame_info#members
+            place_patch();
+            is_patch_stale = false;
             return;
         }
 
-        auto screenshot = ComPtr<ID3D11Texture2D>{};
-        frame_resource.As(&screenshot) >> must::succeed;
+        for (auto const & r : dirty)
+            copy_to_patch(r);
+    }
 
-        // Maybe resize
-        auto source = D3D11_TEXTURE2D_DESC{};
-        screenshot->GetDesc(&source);
-        auto target = D3D11_TEXTURE2D_DESC{};
-        shared_texture->GetDesc(&target);
-        if (source.Width != target.Width || source.Height != target.Height)
+    // Choose the patch for the current triangle and fill it.
+    auto place_patch() -> void
+    {
+        using namespace aux;
+
+        auto const scale_x = static_cast<double>(desktop_width) / window_width;
+        auto const scale_y = static_cast<double>(desktop_height) / window_height;
+        patch              = staging::bounds({current.top_x, current.top_y, current.length}, scale_x, scale_y);
+
+        // Resize in coarse steps, so that zooming doesn't recreate the texture every tick
+        auto const round    = [](UINT v) { return (v + 0xff) & ~0xffu; };
+        auto const width    = round(patch.width);
+        auto const height   = round(patch.height);
+        auto       capacity = D3D11_TEXTURE2D_DESC{};
+        shared_texture->GetDesc(&capacity);
+        if (patch.width > capacity.Width || patch.height > capacity.Height || capacity.Width > width * 2 ||
+            capacity.Height > height * 2)
         {
+            capacity.Width  = width;
+            capacity.Height = height;
             make::shared_texture2d(
                 device11, device, descriptor_heap, descriptor_heap_offsets[1], shared_texture, screenshot_texture,
-                shared_texture_handle, source.Width, source.Height
+                shared_texture_handle, capacity.Width, capacity.Height
             ) >> must::succeed;
         }
 
-        // Copy
-        context11->CopyResource(shared_texture.Get(), screenshot.Get());
+        // Copy what is on the desktop, and zero what is not (just like the border color)
+        auto const shown = visible_patch();
+        if (shown.empty())
+        {
+            clear_patch(0, 0, patch.width, patch.height);
+        }
+        else
+        {
+            auto const left   = static_cast<UINT>(static_cast<std::int32_t>(shown.left) - patch.left);
+            auto const top    = static_cast<UINT>(static_cast<std::int32_t>(shown.top) - patch.top);
+            auto const right  = left + shown.width();
+            auto const bottom = top + shown.height();
+            clear_patch(0, 0, patch.width, top);
+            clear_patch(0, bottom, patch.width, patch.height);
+            clear_patch(0, top, left, bottom);
+            clear_patch(right, top, patch.width, bottom);
+            copy_to_patch(shown);
+        }
+
+        // Map normalized screenshot coordinates into the texture
+        auto const w             = static_cast<float>(capacity.Width);
+        auto const h             = static_cast<float>(capacity.Height);
+        constants.patch_scale_x  = static_cast<float>(desktop_width) / w;
+        constants.patch_scale_y  = static_cast<float>(desktop_height) / h;
+        constants.patch_origin_x = static_cast<float>(patch.left) / w;
+        constants.patch_origin_y = static_cast<float>(patch.top) / h;
+        std::memcpy(constant_buffer_data, &constants, sizeof(constants));
+    }
+
+    // Desktop texels held by the patch.
+    auto visible_patch() const -> image::rect
+    {
+        auto const clamp = [](std::int64_t v, UINT limit)
+        { return static_cast<std::uint32_t>(std::clamp(v, std::int64_t{}, std::int64_t{limit})); };
+        return {
+            clamp(patch.left, desktop_width), clamp(patch.top, desktop_height),
+            clamp(std::int64_t{patch.left} + patch.width, desktop_width),
+            clamp(std::int64_t{patch.top} + patch.height, desktop_height)
+        };
+    }
+
+    // Copy a rect of the desktop into the patch, as far as the patch holds it.
+    auto copy_to_patch(image::rect const & r) -> void
+    {
+        auto const area = image::intersect(r, visible_patch());
+        if (area.empty())
+            return;
+
+        auto const x   = static_cast<UINT>(static_cast<std::int32_t>(area.left) - patch.left);
+        auto const y   = static_cast<UINT>(static_cast<std::int32_t>(area.top) - patch.top);
+        auto       box = D3D11_BOX{area.left, area.top, 0, area.right, area.bottom, 1};
+        context11->CopySubresourceRegion(shared_texture.Get(), 0, x, y, 0, desktop_texture.Get(), 0, &box);
+    }
+
+    // Zero a rect of the patch, in patch texels.
+    auto clear_patch(UINT left, UINT top, UINT right, UINT bottom) -> void
+    {
+        if (left >= right || top >= bottom)
+            return;
+
+        auto const width = right - left;
+        zeros.resize(std::max(zeros.size(), std::size_t{width} * (bottom - top)));
+
+        auto box = D3D11_BOX{left, top, 0, right, bottom, 1};
+        context11->UpdateSubresource(shared_texture.Get(), 0, &box, zeros.data(), width * sizeof(zeros[0]), 0);
+    }
+
+    // Switch between copying the whole desktop and only the patch.
+    auto on_crop(bool on) -> void
+    {
+        using namespace aux;
+
+        if (on == is_cropping)
+            return;
+
+        wait_for_previous_frame();
+        is_cropping = on;
+        schedule.on_update({current.top_x, current.top_y, current.length});
+
+        if (is_cropping)
+        {
+            // The shared texture holds the whole desktop, start from it
+            desktop_texture.Reset();
+            if (!is_screenshot_stale)
+            {
+                auto desc = D3D11_TEXTURE2D_DESC{};
+                shared_texture->GetDesc(&desc);
+                desc.BindFlags = 0;
+                desc.MiscFlags = 0;
+                device11->CreateTexture2D(&desc, nullptr, &desktop_texture) >> must::succeed;
+                context11->CopyResource(desktop_texture.Get(), shared_texture.Get());
+                desktop_width  = desc.Width;
+                desktop_height = desc.Height;
+            }
+            is_screenshot_stale = true;
+            is_patch_stale      = true;
+            return;
+        }
+
+        // The whole desktop is back in the shared texture
+        if (desktop_texture)
+        {
+            make::shared_texture2d(
+                device11, device, descriptor_heap, descriptor_heap_offsets[1], shared_texture, screenshot_texture,
+                shared_texture_handle, desktop_width, desktop_height
+            ) >> must::succeed;
+            context11->CopyResource(shared_texture.Get(), desktop_texture.Get());
+            is_screenshot_stale = false;
+            desktop_texture.Reset();
+        }
+
+        constants.patch_scale_x  = 1.f;
+        constants.patch_scale_y  = 1.f;
+        constants.patch_origin_x = 0.f;
+        constants.patch_origin_y = 0.f;
+        std::memcpy(constant_buffer_data, &constants, sizeof(constants));
+    }
+
+    // Switch between bilinear and point sampling of the screenshot.
+    auto on_nearest(bool on) -> void
+    {
+        constants.nearest = on ? 1.f : 0.f;
+        std::memcpy(constant_buffer_data, &constants, sizeof(constants));
+        schedule.on_update({current.top_x, current.top_y, current.length});
     }
 
     auto on_resize(UINT width, UINT height) -> void
@@ -775,6 +975,38 @@ public:
         window_width  = width;
         window_height = height;
 
+        // 1. - 5. Resize the swap chain
+        resize_output();
+
+        // 6. Create a new shared screenshot texture
+        make::shared_texture2d(
+            device11, device, descriptor_heap, descriptor_heap_offsets[1], shared_texture, screenshot_texture,
+            shared_texture_handle, width, height
+        ) >> must::succeed;
+        is_screenshot_stale = true;
+        is_patch_stale      = true;
+        schedule.on_resize(width, height);
+    }
+
+    // Render "factor" times the window's size, e.g. a 1080p capture to an 8K
+    // wall or a 4K one to a 720p stream. The fold samples the screenshot for
+    // every output pixel anyway, so this costs no pass or buffer of its own.
+    auto on_scale(float factor) -> void
+    {
+        if (!(factor > 0.f) || factor == scale)
+            return;
+
+        scale = factor;
+        resize_output();
+        schedule.on_resize(window_width, window_height); // the next tick fills the new buffers
+    }
+
+    // Swap chain of "scale" times the window's size, shown at the window's
+    // size.
+    auto resize_output() -> void
+    {
+        using namespace aux;
+
         // 1. Wait for command_queue finished
         wait_for_previous_frame();
 
@@ -789,6 +1021,8 @@ public:
         render_target_view_descriptor_heap.Reset();
 
         // 3. Resize swapchain buffer
+        auto const width  = std::max(static_cast<UINT>(std::lround(window_width * scale)), UINT(1));
+        auto const height = std::max(static_cast<UINT>(std::lround(window_height * scale)), UINT(1));
         swap_chain->ResizeBuffers(
             static_cast<UINT>(render_targets.size()), width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 0
         ) >> must::succeed;
@@ -802,31 +1036,36 @@ public:
         render_target_view_descriptor_size = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
         back_buffer_index                  = swap_chain->GetCurrentBackBufferIndex();
 
-        // 6. Create a new shared screenshot texture
-        make::shared_texture2d(
-            device11, device, descriptor_heap, descriptor_heap_offsets[1], shared_texture, screenshot_texture,
-            shared_texture_handle, width, height
-        ) >> must::succeed;
+        // Shown at the window's size again
+        auto const shrink = D2D_MATRIX_3X2_F{1.f / scale, 0.f, 0.f, 1.f / scale, 0.f, 0.f};
+        composition_visual->SetTransform(shrink) >> must::succeed;
+        composition_device->Commit() >> must::succeed;
     }
 
     auto on_update(aligned_regular_triangle const & source) -> void
     {
+        current        = source;
+        is_patch_stale = true;
+        schedule.on_update({source.top_x, source.top_y, source.length});
+
         // Helper
         auto constexpr half_sqrt3 = 0.86602540378443864676372317075294f;
         auto w                    = static_cast<float>(window_width);
         auto h                    = static_cast<float>(window_height);
 
         // Update constant buffer (normalization)
-        auto target   = triangle_constant_buffer{};
-        target.top_x  = source.top_x / w;
-        target.top_y  = source.top_y / h;
-        target.length = source.length / w;
-        target.height = source.length * half_sqrt3 / h;
-
-        std::memcpy(constant_buffer_data, &target, sizeof(target));
+        //
+        // The triangle is in window pixels, whatever the size of the swap
+        // chain: the shader works in coordinates normalized to either.
+        constants.top_x  = source.top_x / w;
+        constants.top_y  = source.top_y / h;
+        constants.length = source.length / w;
+        constants.height = source.length * half_sqrt3 / h;
+
+        std::memcpy(constant_buffer_data, &constants, sizeof(constants));
     }
 
-    auto on_render() -> void
+    auto on_render() -> bool
     {
         using namespace aux;
         using wrl::ComPtr;
@@ -838,6 +1077,10 @@ public:
         // Grab a screenshot from OutputDuplication
         update_screenshot();
 
+        // Keep the previous frame if nothing visible changed
+        if (!schedule.on_tick())
+            return false;
+
         // Reset command list
         command_allocator->Reset() >> must::succeed;
         command_list->Reset(command_allocator.Get(), pipeline_state.Get()) >> must::succeed;
@@ -903,6 +1146,7 @@ public:
 
         // Present back buffer
         swap_chain->Present(1, 0) >> must::succeed;
+        return true;
     }
 
 public:
@@ -913,6 +1157,11 @@ public:
         float top_y;
         float length;
         float height;
+        float patch_scale_x;
+        float patch_scale_y;
+        float patch_origin_x;
+        float patch_origin_y;
+        float nearest; // non-zero: point sampling
     };
 
     // Define the input layout for vertex shader
@@ -937,9 +1186,10 @@ public:
     };
 
 public:
-    HWND window_instance;
-    UINT window_width;
-    UINT window_height;
+    HWND  window_instance;
+    UINT  window_width;
+    UINT  window_height;
+    float scale{1.f}; // of the swap chain, see "on_scale"
 
     // Device and Command Queue
     wrl::ComPtr<ID3D12Device>           device{};
@@ -968,10 +1218,10 @@ public:
     //
     // Refer to
     // https://stackoverflow.com/a/40294831
-    wrl::ComPtr<ID3D11Device>           device11{};
-    wrl::ComPtr<ID3D11DeviceContext>    context11{};
-    wrl::ComPtr<IDXGIOutput1>           output{};
-    wrl::ComPtr<IDXGIOutputDuplication> output_duplication{};
+    wrl::ComPtr<ID3D11Device>             device11{};
+    wrl::ComPtr<ID3D11DeviceContext>      context11{};
+    wrl::ComPtr<IDXGIOutput1>             output{};
+    std::unique_ptr<capture::duplication> screen{};
 
     // Resources
     wrl::ComPtr<ID3D12RootSignature>       root_signature{};
@@ -982,6 +1232,7 @@ public:
 
     wrl::ComPtr<ID3D12Resource> constant_buffer{};
     UINT8 *                     constant_buffer_data{};
+    triangle_constant_buffer    constants{0.f, 0.f, 0.f, 0.f, 1.f, 1.f, 0.f, 0.f, 0.f};
 
     wrl::ComPtr<ID3D12Resource> vertex_buffer{};
     D3D12_VERTEX_BUFFER_VIEW    vertex_buffer_view{};
@@ -992,6 +1243,20 @@ public:
     wrl::ComPtr<ID3D11Texture2D> shared_texture{};
     wrl::ComPtr<ID3D12Resource>  screenshot_texture{};
     HANDLE                       shared_texture_handle{};
+    bool                         is_screenshot_stale{true}; // shared_texture doesn't hold the last frame
+
+    // Crop capture, see "update_patch"
+    aligned_regular_triangle     current{};
+    wrl::ComPtr<ID3D11Texture2D> desktop_texture{};
+    UINT                         desktop_width{};
+    UINT                         desktop_height{};
+    staging::region              patch{};
+    std::vector<std::uint32_t>   zeros{};
+    bool                         is_cropping{};
+    bool                         is_patch_stale{true}; // shared_texture doesn't hold the patch of "current"
+
+    // Skips ticks without visible changes
+    schedule::scheduler schedule{};
 
     // Synchronization objects
     HANDLE                   fence_event{};
@@ -1019,12 +1284,32 @@ auto mirror::on_resize(std::uint32_t width, std::uint32_t height) -> void
     o->on_resize(static_cast<UINT>(width), static_cast<UINT>(height));
 }
 
-auto mirror::on_render() -> void
+auto mirror::on_render() -> bool
 {
-    o->on_render();
+    return o->on_render();
 }
 
 auto mirror::on_update(aligned_regular_triangle const & triangle) -> void
 {
     o->on_update(triangle);
 }
+
+auto mirror::on_scale(float factor) -> void
+{
+    o->on_scale(factor);
+}
+
+auto mirror::on_crop(bool on) -> void
+{
+    o->on_crop(on);
+}
+
+auto mirror::on_nearest(bool on) -> void
+{
+    o->on_nearest(on);
+}
+
+auto mirror::counters() const -> frame_counters
+{
+    return {o->schedule.rendered_frames(), o->schedule.skipped_frames()};
+}
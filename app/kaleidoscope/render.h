@@ -17,14 +17,25 @@ public:
         float length;
     };
 
+    // Ticks of "on_render" that drew a frame, or kept the previous one.
+    struct frame_counters
+    {
+        std::uint64_t rendered;
+        std::uint64_t skipped;
+    };
+
 public:
     ~mirror();
     mirror(HWND window, std::uint32_t width, std::uint32_t height);
 
 public:
     auto on_resize(std::uint32_t width, std::uint32_t height) -> void;
-    auto on_render() -> void;
+    auto on_render() -> bool;
     auto on_update(aligned_regular_triangle const & triangle) -> void;
+    auto on_scale(float factor) -> void; // render "factor" times the window's size, shown at the window's size
+    auto on_crop(bool on) -> void; // copy only the triangle's bounding box of each frame
+    auto on_nearest(bool on) -> void; // point instead of bilinear sampling
+    auto counters() const -> frame_counters;
 
 private:
     struct core;
@@ -72,6 +72,17 @@ auto static inline set_top_most(HWND hwnd, bool on) -> LONG_PTR
     auto option = on ? HWND_TOPMOST : HWND_NOTOPMOST;
     return SetWindowPos(hwnd, option, 0, 0, 0, 0, SWP_NOACTIVATE | SWP_NOMOVE | SWP_NOSIZE);
 }
+
+// Print rendered and skipped frames to the debugger every "every" ticks.
+auto static inline report_frames(mirror const & render, std::uint64_t every) -> void
+{
+    auto [rendered, skipped] = render.counters();
+    if ((rendered + skipped) % every != 0)
+        return;
+
+    auto text = "frames: " + std::to_string(rendered) + " rendered, " + std::to_string(skipped) + " skipped\n";
+    OutputDebugString(text.c_str());
+}
 } // namespace ext
 
 namespace app
@@ -98,6 +109,12 @@ auto static constexpr menu_item_no_capture      = UINT_PTR{1001};
 auto static constexpr menu_item_no_capture_text = TEXT("Exclude from capture");
 auto static constexpr menu_item_top_most        = UINT_PTR{1002};
 auto static constexpr menu_item_top_most_text   = TEXT("Keep top most");
+auto static constexpr menu_item_crop            = UINT_PTR{1003};
+auto static constexpr menu_item_crop_text       = TEXT("Copy only the triangle");
+auto static constexpr menu_item_nearest         = UINT_PTR{1004};
+auto static constexpr menu_item_nearest_text    = TEXT("Nearest sampling");
+auto static constexpr menu_item_double          = UINT_PTR{1005};
+auto static constexpr menu_item_double_text     = TEXT("Render at twice the size");
 
 auto static inline handle_liftime(HWND hwnd, UINT umsg, WPARAM wparam, LPARAM lparam) -> extended_data *
 {
@@ -147,6 +164,9 @@ auto static inline handle_liftime(HWND hwnd, UINT umsg, WPARAM wparam, LPARAM lp
         auto menu = udata->menu;
         AppendMenu(menu, MF_STRING, menu_item_top_most, menu_item_top_most_text);
         AppendMenu(menu, MF_STRING, menu_item_no_capture, menu_item_no_capture_text);
+        AppendMenu(menu, MF_STRING, menu_item_crop, menu_item_crop_text);
+        AppendMenu(menu, MF_STRING, menu_item_nearest, menu_item_nearest_text);
+        AppendMenu(menu, MF_STRING, menu_item_double, menu_item_double_text);
         AppendMenu(menu, MF_SEPARATOR, 0, nullptr);
         AppendMenu(menu, MF_STRING, menu_item_exit, menu_item_exit_text);
         {
@@ -159,6 +179,21 @@ auto static inline handle_liftime(HWND hwnd, UINT umsg, WPARAM wparam, LPARAM lp
             ext::set_exclude_from_capture(hwnd, option) >> must::done;
             ext::switch_menu_item(menu, menu_item_no_capture, option);
         }
+        {
+            auto option = udata->state.option_crop_capture();
+            udata->render->on_crop(option);
+            ext::switch_menu_item(menu, menu_item_crop, option);
+        }
+        {
+            auto option = udata->state.option_nearest_sampling();
+            udata->render->on_nearest(option);
+            ext::switch_menu_item(menu, menu_item_nearest, option);
+        }
+        {
+            auto option = udata->state.option_double_output();
+            udata->render->on_scale(option ? 2.f : 1.f);
+            ext::switch_menu_item(menu, menu_item_double, option);
+        }
 
         // Setup a timer to render
         //
@@ -201,7 +236,10 @@ auto static inline handle_common_events(HWND hwnd, UINT umsg, WPARAM wparam, LPA
         switch (wparam)
         {
         case render_timer_id:
+            // Only draws if the screenshot, the triangle or the size changed
             render.on_render();
+            if constexpr (env::is_debug())
+                ext::report_frames(render, 300);
             return 0;
         }
         return std::nullopt;
@@ -218,7 +256,7 @@ auto static inline handle_common_events(HWND hwnd, UINT umsg, WPARAM wparam, LPA
         // this window, I choose to extend the transparents area.
         ext::expand_triangle(points, state.is_moving());
 
-        // Repaint
+        // Repaint, if there's anything new since the last timer tick
         render.on_render();
 
         // Prepare to repaint transparent area with gdi
@@ -367,6 +405,27 @@ auto static inline handle_menu(HWND hwnd, UINT umsg, WPARAM wparam, LPARAM lpara
         ext::switch_menu_item(data.menu, menu_item_no_capture, option);
         return 0;
     }
+    case menu_item_crop:
+    {
+        auto option = state.option_crop_capture(true);
+        data.render->on_crop(option);
+        ext::switch_menu_item(data.menu, menu_item_crop, option);
+        return 0;
+    }
+    case menu_item_nearest:
+    {
+        auto option = state.option_nearest_sampling(true);
+        data.render->on_nearest(option);
+        ext::switch_menu_item(data.menu, menu_item_nearest, option);
+        return 0;
+    }
+    case menu_item_double:
+    {
+        auto option = state.option_double_output(true);
+        data.render->on_scale(option ? 2.f : 1.f);
+        ext::switch_menu_item(data.menu, menu_item_double, option);
+        return 0;
+    }
     case menu_item_exit:
     {
         DestroyWindow(hwnd);
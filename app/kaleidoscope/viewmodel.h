@@ -2,6 +2,7 @@
 #include <chrono>
 
 #include "model.h"
+#include "wheel.h"
 
 namespace viewmodel
 {
@@ -41,15 +42,8 @@ public:
 
     auto on_length_changed(std::integral auto delta) -> void
     {
-        using namespace std::chrono_literals;
-        using time_unit                  = std::chrono::duration<I, std::milli>;
-        auto static constexpr threshold  = 333ms;
-        auto static constexpr accelerate = std::array<std::pair<time_unit, I>, 6>{
-            {{1600ms, 13}, {1000ms, 8}, {600ms, 5}, {400ms, 3}, {200ms, 2}, {0ms, 1}}
-        };
-
-        auto factor = accelerate.back().second;
-        if (auto now = std::chrono::steady_clock::now(); now - zooming_previous > threshold)
+        auto factor = wheel::acceleration.back().second;
+        if (auto now = wheel::clock::now(); now - zooming_previous > wheel::threshold)
         {
             zooming_previous  = now;
             zooming_beginning = now;
@@ -57,15 +51,7 @@ public:
         else
         {
             zooming_previous = now;
-
-            for (auto x = now - zooming_beginning; auto && [k, y] : accelerate)
-            {
-                if (x > k)
-                {
-                    factor = y;
-                    break;
-                }
-            }
+            factor           = wheel::step(now - zooming_beginning);
         }
 
         viewport.zoom(static_cast<I>(delta) * factor);
@@ -119,6 +105,33 @@ public:
         return is_keeping_top_most;
     }
 
+    auto option_crop_capture(bool toggle = false) -> bool
+    {
+        if (toggle)
+        {
+            is_cropping_capture = !is_cropping_capture;
+        }
+        return is_cropping_capture;
+    }
+
+    auto option_nearest_sampling(bool toggle = false) -> bool
+    {
+        if (toggle)
+        {
+            is_sampling_nearest = !is_sampling_nearest;
+        }
+        return is_sampling_nearest;
+    }
+
+    auto option_double_output(bool toggle = false) -> bool
+    {
+        if (toggle)
+        {
+            is_doubling_output = !is_doubling_output;
+        }
+        return is_doubling_output;
+    }
+
 private:
     // Model
     model_type viewport{};
@@ -126,6 +139,9 @@ private:
     // Options
     bool is_excluded_from_capture{true};
     bool is_keeping_top_most{true};
+    bool is_cropping_capture{};
+    bool is_sampling_nearest{};
+    bool is_doubling_output{};
 
     // States
     bool       is_dragging{};
@@ -0,0 +1,1486 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "cpu.h"
+#include "deferred.h"
+#include "direct.h"
+#include "dirty.h"
+#include "fold.h"
+#include "fold_map.h"
+#include "gallery.h"
+#include "image.h"
+#include "parallel.h"
+#include "previews.h"
+#include "period_tile.h"
+#include "planar.h"
+#include "sample.h"
+#include "scanline.h"
+#include "schedule.h"
+#include "sequence.h"
+#include "source.h"
+#include "synthetic.h"
+#include "tile_cache.h"
+#include "wheel.h"
+#include "yuv.h"
+
+// Usage: kaleidoscope_bench [options]
+//
+//   --variant    NAME[,NAME...]  only run these variants (default: all)
+//   --resolution NAME[,NAME...]  720p, 1080p, 1440p, 4k, 8k (default: all)
+//   --length     N[,N...]        side lengths in pixels, "max" for the
+//                                largest one allowed (default: 8,32,128,max)
+//   --threads    N[,N...]        thread counts (default: 1 and all cores)
+//   --time       SECONDS         minimum time per measurement (default: 0.25)
+//   --isa        NAME[,NAME...]  baseline, sse4.2, avx2, avx512: run the
+//                                kernels built for these levels (default: the
+//                                best one the processor supports)
+//   --check      N               compare every output to the scalar reference,
+//                                "kernel::direct" at the baseline level with
+//                                the variant's filter, and fail if any
+//                                channel is off by more than N plus the
+//                                variant's own tolerance, see "variant"
+//   --output     NAME            render every resolution to this one instead,
+//                                e.g. "--resolution 1080p --output 8k"; the
+//                                triangles are placed in output pixels
+//
+// Streaming mode, feeding frames from a "capture::frame_source" through the
+// whole capture and render path instead of one fixed image:
+//
+//   --source     synthetic|DIR   generated frames at the first resolution,
+//                                or the PPM files of a directory
+//   --fps        N               frames per second of the source, 0 for as
+//                                fast as possible (default: 0)
+//   --frames     N               frames per run (default: 300)
+//   --full       1               render whole frames instead of the areas
+//                                "dirty::tracker" finds
+//   --verify     1               compare every frame to a full render
+//
+// Streaming runs at the first level of "--isa".
+//
+// Cache mode, for the variants that can list the texels they read:
+//
+//   --misses     1               replay the reads of one frame through a
+//                                simulated 32 KiB L1 and 1 MiB L2 data cache,
+//                                and show the misses per output pixel
+//
+// Zoom mode, turning the wheel at a fixed pace from length 32 at the center
+// of each resolution, with "fold_map/tiles" on an empty cache:
+//
+//   --zoom       N               notches per run
+//   --notch      MS              milliseconds between notches (default: 50)
+//
+// Each run is made twice, with and without a "wheel::prebuilder", and times
+// the frames after the notches, which stall where a tile has to be made.
+//
+// Stack mode, folding the output again with smaller triangles inside the
+// first one, at the center of each resolution and each "--length":
+//
+//   --stack      N               stages, rendered as N passes of
+//                                "fold_map/crop" through intermediate frames,
+//                                and as one "fold_map/crop" of all of them
+//
+// "buffers MB" are the tables and intermediate frames, "err" the largest
+// difference of a channel of the stack from the passes, which resample
+// every intermediate frame.
+//
+// Gallery mode, thumbnails of one frame at a quarter of each resolution,
+// with triangles of all sizes spread over them:
+//
+//   --gallery    N               thumbnails, rendered one after the other by
+//                                one "engine::direct" and one
+//                                "engine::scanline", and by "engine::gallery"
+//
+// Preview mode, at the center of each resolution and each "--length":
+//
+//   --preview    N[,N...]        also make copies of 1/N the size of every
+//                                frame: by a second instance of the variant
+//                                per copy, by reducing the frame after it is
+//                                rendered, and by "previews::render", which
+//                                reduces every band right after rendering it
+//
+// "err" is the largest difference of a channel between the last two.
+//
+// YUV mode, at the center of each resolution and each "--length", with the
+// inside of the triangle showing the source, as a recording does:
+//
+//   --yuv        nv12|i420       render "fold_map/crop" in BGRA and convert
+//                                every frame to this format, and fold into it
+//                                directly with "engine::planar", from the
+//                                BGRA capture and from a capture in the
+//                                format
+//
+// "y err" and "uv err" are the largest differences of a luma and a chroma
+// value between the converted frame and the one folded from the capture.
+// "drag 1 ms" and "drag 2 ms" are the first "engine::planar" frames after
+// a move by one and by two pixels, as "drag" below. A move by one pixel is
+// half a texel of chroma, so these are measured once the chroma table of
+// each phase has been made.
+//
+// Every measurement is the fastest of repeated frames after one warm up
+// frame. "setup" is the first frame after a triangle change, which is where
+// table based variants pay for their tables. "drag" is the first frame after
+// a move by one pixel, the mean of one move away and one back, which is what
+// every frame of a drag costs.
+//
+// "err" is the largest difference of a channel from the reference, with
+// "--check" only.
+//
+// "B/px" counts the bytes a frame has to touch at least, divided by output
+// pixels: the output, the source triangle, plus the variant's own tables.
+
+namespace bench
+{
+
+struct resolution
+{
+    std::string_view name;
+    std::uint32_t    width;
+    std::uint32_t    height;
+};
+
+auto constexpr resolutions = std::array<resolution, 5>{{
+    {"720p", 1280, 720},
+    {"1080p", 1920, 1080},
+    {"1440p", 2560, 1440},
+    {"4k", 3840, 2160},
+    {"8k", 7680, 4320},
+}};
+
+// Type erased engine, so that all variants share one measuring loop.
+struct instance
+{
+    std::function<void(std::uint32_t, std::uint32_t)>          on_resize;
+    std::function<void(fold::aligned_regular_triangle const &)> on_update;
+    std::function<void(image::const_view)>                     on_capture;
+    std::function<void(parallel::pool &, image::view)>         on_render;
+    std::function<void(parallel::pool &, image::view, std::span<image::rect const>)> on_render_areas;
+    std::function<void(parallel::pool &, image::view, std::span<image::view const>)> on_render_previews;
+    std::function<std::size_t()>                               footprint;
+    std::function<bool()>                                      switched; // whole output dirty, see "deferred"
+    std::function<void(std::function<void(std::size_t)> const &)> trace; // for "--misses", may be empty
+};
+
+// Every measurement starts from a fresh instance, so that "setup" always
+// includes building the tables.
+struct variant
+{
+    std::string_view          name;
+    std::function<instance()> create;
+    sample::filter            filter{};    // of the reference to compare with
+    int                       tolerance{}; // largest expected difference from it
+    double                    strays{};    // share of pixels that may differ by more
+};
+
+// "kind" for variants that may differ from the reference by up to
+// "tolerance" by design. Those that don't resolve every pixel where it is,
+// but repeat a period or shift their tables along a drag, differ by up to 2,
+// as the fold is float math on normalized coordinates, which doesn't give
+// the same result for a pixel and the triangle both moved by whole texels.
+// With point sampling such a pixel on a tie shows the neighbouring texel,
+// and the rotated copies resample the source once more.
+//
+// With point sampling, a pixel whose fold lands on a tie may show the
+// neighbouring texel instead, which can differ by anything. Those are a few
+// pixels per frame, so "strays" bounds their share instead of "tolerance".
+auto tolerant(variant kind, int tolerance, double strays = 0.) -> variant
+{
+    kind.tolerance = tolerance;
+    kind.strays    = strays;
+    return kind;
+}
+
+template <typename E, typename... A> auto make(std::string_view name, A... args) -> variant
+{
+    auto filter = sample::filter::linear;
+    ([&] { if constexpr (std::is_same_v<A, sample::filter>) filter = args; }(), ...);
+
+    auto create = [=]
+    {
+        auto e         = std::make_shared<E>(args...);
+        auto out       = instance{};
+        out.on_resize  = [e](std::uint32_t w, std::uint32_t h) { e->on_resize(w, h); };
+        out.on_update  = [e](fold::aligned_regular_triangle const & t) { e->on_update(t); };
+        out.on_capture = [e](image::const_view source) { e->on_capture(source); };
+        out.on_render  = [e](parallel::pool & workers, image::view target) { parallel::render(workers, *e, target); };
+        out.on_render_areas = [e](parallel::pool & workers, image::view target, std::span<image::rect const> areas)
+        { parallel::render(workers, *e, target, areas); };
+        out.on_render_previews = [e](parallel::pool & workers, image::view target, std::span<image::view const> smaller)
+        { previews::render(workers, *e, target, smaller); };
+        out.footprint  = [] { return std::size_t{}; };
+        if constexpr (requires { e->footprint(); })
+            out.footprint = [e] { return e->footprint(); };
+        out.switched   = [] { return false; };
+        if constexpr (requires { e->switched(); })
+            out.switched = [e] { return e->switched(); };
+        if constexpr (requires { e->trace([](std::size_t) {}); })
+            out.trace = [e](std::function<void(std::size_t)> const & visit) { e->trace(visit); };
+        return out;
+    };
+    return {name, create, filter};
+}
+
+auto variants() -> std::vector<variant>
+{
+    using method           = engine::period_tile::method;
+    auto constexpr full    = staging::mode::full;
+    auto constexpr crop    = staging::mode::crop;
+    auto constexpr rotated = staging::mode::rotated;
+    auto constexpr point   = sample::filter::point;
+
+    // Shared by every measurement and kept across runs, so "setup" of
+    // "fold_map/tiles" is a copy for every length seen before.
+    auto const cache = std::make_shared<tiles::cache>(std::filesystem::temp_directory_path() / "kaleidoscope_tiles");
+    return {
+        make<engine::direct>("direct"),
+        make<engine::direct>("direct/crop", crop),
+        make<engine::fold_map>("fold_map"),
+        tolerant(make<engine::fold_map>("fold_map/crop", crop), 2),
+        tolerant(make<engine::fold_map>("fold_map/blocks", staging::mode::blocks), 2),
+        tolerant(make<engine::fold_map>("fold_map/morton", staging::mode::morton), 2),
+        tolerant(make<engine::fold_map>("fold_map/tiles", crop, sample::filter::linear, cache), 2),
+        tolerant(make<engine::deferred>("fold_map/deferred", crop), 2),
+        tolerant(make<engine::period_tile>("period_tile/fold", method::fold), 2),
+        tolerant(make<engine::period_tile>("period_tile/reflection", method::reflection), 2),
+        tolerant(
+            make<engine::period_tile>("period_tile/rotated", method::reflection, sample::filter::linear, rotated), 88
+        ),
+        tolerant(make<engine::scanline>("scanline"), 2),
+        tolerant(make<engine::scanline>("scanline/rotated", sample::filter::linear, rotated), 88),
+        make<engine::direct>("direct/point", full, point),
+        make<engine::fold_map>("fold_map/point", full, point),
+        tolerant(make<engine::fold_map>("fold_map/crop/point", crop, point), 0, 2e-4),
+        tolerant(make<engine::period_tile>("period_tile/point", method::reflection, point), 0, 2e-4),
+        tolerant(make<engine::scanline>("scanline/point", point), 0, 2e-4),
+    };
+}
+
+struct options
+{
+    std::vector<std::string>   variants{};
+    std::vector<std::string>   resolutions{};
+    std::vector<std::string>   lengths{"8", "32", "128", "max"};
+    std::vector<std::uint32_t> threads{};
+    std::vector<cpu::isa>      isas{};
+    double                     seconds{.25};
+    int                        tolerance{-1};
+    std::string                source{};
+    double                     fps{};
+    std::uint64_t              frames{300};
+    bool                       full{};
+    bool                       verify{};
+    std::uint32_t              notches{};
+    double                     notch{50.};
+    bool                       misses{};
+    std::uint32_t              stages{};
+    std::uint32_t              thumbnails{};
+    std::vector<std::uint32_t> shrink{};
+    std::string                output{};
+    std::string                yuv{};
+};
+
+auto split(std::string_view text) -> std::vector<std::string>
+{
+    auto out = std::vector<std::string>{};
+    while (!text.empty())
+    {
+        auto comma = text.find(',');
+        out.emplace_back(text.substr(0, comma));
+        text = comma == std::string_view::npos ? std::string_view{} : text.substr(comma + 1);
+    }
+    return out;
+}
+
+auto parse(int argc, char ** argv) -> options
+{
+    auto out = options{};
+    for (auto i = 1; i + 1 < argc; i += 2)
+    {
+        auto key   = std::string_view{argv[i]};
+        auto value = std::string_view{argv[i + 1]};
+        if (key == "--variant")
+            out.variants = split(value);
+        else if (key == "--resolution")
+            out.resolutions = split(value);
+        else if (key == "--length")
+            out.lengths = split(value);
+        else if (key == "--time")
+            out.seconds = std::atof(argv[i + 1]);
+        else if (key == "--source")
+            out.source = value;
+        else if (key == "--fps")
+            out.fps = std::atof(argv[i + 1]);
+        else if (key == "--frames")
+            out.frames = std::strtoull(argv[i + 1], nullptr, 10);
+        else if (key == "--full")
+            out.full = value != "0";
+        else if (key == "--verify")
+            out.verify = value != "0";
+        else if (key == "--misses")
+            out.misses = value != "0";
+        else if (key == "--zoom")
+            out.notches = static_cast<std::uint32_t>(std::max(0, std::atoi(argv[i + 1])));
+        else if (key == "--stack")
+            out.stages = static_cast<std::uint32_t>(std::max(0, std::atoi(argv[i + 1])));
+        else if (key == "--gallery")
+            out.thumbnails = static_cast<std::uint32_t>(std::max(0, std::atoi(argv[i + 1])));
+        else if (key == "--preview")
+            for (auto & n : split(value))
+                out.shrink.push_back(static_cast<std::uint32_t>(std::max(1, std::atoi(n.c_str()))));
+        else if (key == "--notch")
+            out.notch = std::max(0., std::atof(argv[i + 1]));
+        else if (key == "--output")
+            out.output = value;
+        else if (key == "--yuv")
+            out.yuv = value;
+        else if (key == "--check")
+            out.tolerance = std::max(0, std::atoi(argv[i + 1]));
+        else if (key == "--threads")
+            for (auto & n : split(value))
+                out.threads.push_back(static_cast<std::uint32_t>(std::max(1, std::atoi(n.c_str()))));
+        else if (key == "--isa")
+            for (auto & n : split(value))
+                if (auto level = cpu::parse(n); level && cpu::supports(*level))
+                    out.isas.push_back(*level);
+                else
+                    throw std::invalid_argument("unsupported isa " + n);
+        else
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+    }
+
+    if (out.threads.empty())
+    {
+        auto cores = std::max(1u, std::thread::hardware_concurrency());
+        out.threads.push_back(1);
+        if (cores > 1)
+            out.threads.push_back(cores);
+    }
+    if (out.isas.empty())
+        out.isas.push_back(cpu::active());
+    return out;
+}
+
+auto selected(std::vector<std::string> const & filter, std::string_view name) -> bool
+{
+    return filter.empty() || std::find(filter.begin(), filter.end(), name) != filter.end();
+}
+
+// A deterministic screenshot-like source: gradients and a checkerboard.
+auto make_source(std::uint32_t width, std::uint32_t height) -> image::frame
+{
+    auto source = image::frame(width, height);
+    auto view   = source.view();
+    for (auto y = 0u; y < height; ++y)
+    {
+        for (auto x = 0u; x < width; ++x)
+        {
+            auto r        = (x * 255 / std::max(width - 1, 1u)) & 0xff;
+            auto g        = (y * 255 / std::max(height - 1, 1u)) & 0xff;
+            auto b        = ((x / 16 + y / 16) & 1) ? 0xe0u : 0x20u;
+            view.at(x, y) = 0xff000000u | (r << 16) | (g << 8) | b;
+        }
+    }
+    return source;
+}
+
+// Same clamps as "model::scoped_triangle".
+auto max_length(double width, double height, double top_x, double top_y) -> double
+{
+    auto x_limit = std::min(width - top_x, top_x) * 2.;
+    auto y_limit = (height - top_y) * 2. / std::sqrt(3.);
+    return std::max(8., std::min(x_limit, y_limit));
+}
+
+struct placement
+{
+    std::string_view               name;
+    fold::aligned_regular_triangle triangle;
+};
+
+// Center, the top left corner and the bottom right corner of the screen.
+auto placements(resolution const & r, std::string const & length) -> std::vector<placement>
+{
+    auto const w      = static_cast<double>(r.width);
+    auto const h      = static_cast<double>(r.height);
+    auto const limit  = std::floor(max_length(w, h, w / 2., h / 2.));
+    auto const side   = length == "max" ? limit : std::clamp(std::atof(length.c_str()), 8., limit);
+    auto const height = side * std::sqrt(3.) / 2.;
+
+    auto at = [&](double x, double y)
+    {
+        return fold::aligned_regular_triangle{
+            static_cast<float>(std::floor(x)),
+            static_cast<float>(std::floor(y)),
+            static_cast<float>(side),
+        };
+    };
+
+    return {
+        {"center", at(w / 2., h / 2.)},
+        {"top-left", at(side / 2., 0.)},
+        {"bottom-right", at(w - side / 2., h - height)},
+    };
+}
+
+using timer = std::chrono::steady_clock;
+
+auto milliseconds(timer::duration d) -> double
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// The scalar reference: the shader's fold per pixel with scalar sampling,
+// at the size of "output".
+auto reference(
+    image::const_view source, resolution const & output, fold::aligned_regular_triangle const & triangle,
+    sample::filter filter
+) -> image::frame
+{
+    auto const level = cpu::active();
+    auto       out   = image::frame(output.width, output.height);
+    auto       e     = engine::direct{staging::mode::full, filter};
+    cpu::force(cpu::isa::baseline);
+    e.on_resize(output.width, output.height);
+    e.on_update(triangle);
+    e.on_capture(source);
+    e.on_render(out.view());
+    cpu::force(level);
+    return out;
+}
+
+// Pixels with any channel off by more than "limit" between two images of the
+// same size.
+auto strays(image::const_view a, image::const_view b, int limit) -> std::uint64_t
+{
+    auto count = std::uint64_t{};
+    for (auto y = 0u; y < a.height; ++y)
+    {
+        auto const p = a.row(y);
+        auto const q = b.row(y);
+        for (auto x = 0u; x < a.width; ++x)
+        {
+            if (p[x] == q[x])
+                continue;
+
+            for (auto shift = 0; shift < 32; shift += 8)
+            {
+                auto const u = static_cast<int>((p[x] >> shift) & 0xff);
+                auto const v = static_cast<int>((q[x] >> shift) & 0xff);
+                if (u - v > limit || v - u > limit)
+                {
+                    ++count;
+                    break;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+// Largest difference of any channel between two images of the same size.
+auto difference(image::const_view a, image::const_view b) -> int
+{
+    auto most = 0;
+    for (auto y = 0u; y < a.height; ++y)
+    {
+        auto const p = a.row(y);
+        auto const q = b.row(y);
+        for (auto x = 0u; x < a.width; ++x)
+        {
+            if (p[x] == q[x])
+                continue;
+
+            for (auto shift = 0; shift < 32; shift += 8)
+            {
+                auto const u = static_cast<int>((p[x] >> shift) & 0xff);
+                auto const v = static_cast<int>((q[x] >> shift) & 0xff);
+                most         = std::max(most, u > v ? u - v : v - u);
+            }
+        }
+    }
+    return most;
+}
+
+// One line of the sweep: the fastest frame of "kind" for "triangle".
+auto measure(
+    options const & o, variant const & kind, parallel::pool & workers, resolution const & r,
+    image::const_view source, image::view target, image::const_view expected, placement const & where
+) -> void
+{
+    auto const & triangle = where.triangle;
+    auto         v        = kind.create();
+    v.on_resize(r.width, r.height);
+    v.on_update(triangle);
+
+    auto frame = [&]
+    {
+        v.on_capture(source);
+        v.on_render(workers, target);
+    };
+
+    auto begin = timer::now();
+    frame();
+    auto setup = timer::now() - begin;
+
+    // Away and back, the cost of every frame of a drag
+    auto drag = timer::duration::zero();
+    for (auto step : {1.f, 0.f})
+    {
+        auto moved = triangle;
+        moved.top_x += step;
+        moved.top_y += step;
+        v.on_update(moved);
+
+        auto start = timer::now();
+        frame();
+        drag += (timer::now() - start) / 2;
+    }
+
+    auto best  = timer::duration::max();
+    auto spent = timer::duration::zero();
+    for (auto count = 0; count < 3 || milliseconds(spent) < o.seconds * 1000.; ++count)
+    {
+        auto start = timer::now();
+        frame();
+        auto took = timer::now() - start;
+        best      = std::min(best, took);
+        spent += took;
+    }
+
+    // Output, source triangle (half its bounding box) and tables
+    auto const level  = cpu::name(cpu::active());
+    auto const pixels = static_cast<double>(r.width) * r.height;
+    auto const ms     = milliseconds(best);
+    auto const area   = static_cast<double>(triangle.length) * triangle.length * fold::half_sqrt3 * .5;
+    auto const bytes  = (pixels + area) * sizeof(image::pixel) + static_cast<double>(v.footprint());
+    auto const limit  = o.tolerance + kind.tolerance;
+    auto       off    = o.tolerance < 0 ? 0 : difference(target, expected);
+    auto       stray  = o.tolerance < 0 ? std::uint64_t{} : strays(target, expected, limit);
+
+    // And a drag that stays, towards the center, against the reference at
+    // its end, which a table shifted there has to match too
+    if (o.tolerance >= 0)
+    {
+        auto moved = triangle;
+        moved.top_x += triangle.top_x < r.width / 2.f ? 5.f : -5.f;
+        moved.top_y += triangle.top_y < r.height / 2.f ? 3.f : -3.f;
+        v.on_update(moved);
+        frame();
+        auto const there = reference(source, r, moved, kind.filter);
+        off              = std::max(off, difference(target, there.const_view()));
+        stray            = std::max(stray, strays(target, there.const_view(), limit));
+    }
+    auto const error = o.tolerance < 0 ? std::string{"-"} : std::to_string(off);
+    std::printf(
+        "%-24.*s %-8.*s %-6.*s %6.0f %-12.*s %4zu %10.3f %10.3f %10.3f %10.1f %8.2f %8.2f %4s\n",
+        static_cast<int>(kind.name.size()), kind.name.data(), static_cast<int>(level.size()), level.data(),
+        static_cast<int>(r.name.size()), r.name.data(), triangle.length, static_cast<int>(where.name.size()),
+        where.name.data(), workers.size(), milliseconds(setup), milliseconds(drag), ms, pixels / ms / 1e3,
+        ms * 1e6 / pixels, bytes / pixels, error.c_str()
+    );
+    std::fflush(stdout);
+
+    if (static_cast<double>(stray) > kind.strays * pixels && o.tolerance >= 0)
+        throw std::runtime_error("output differs from the reference by more than the tolerance");
+}
+
+// The resolution "--output" names, else "r" itself.
+auto output_of(options const & o, resolution const & r) -> resolution
+{
+    for (auto const & candidate : resolutions)
+        if (candidate.name == o.output)
+            return candidate;
+    return r;
+}
+
+auto run(options const & o) -> void
+{
+    std::printf(
+        "%-24s %-8s %-6s %6s %-12s %4s %10s %10s %10s %10s %8s %8s %4s\n", "variant", "isa", "res", "length",
+        "position", "thr", "setup ms", "drag ms", "frame ms", "Mpx/s", "ns/px", "B/px", "err"
+    );
+
+    auto pools = std::vector<std::unique_ptr<parallel::pool>>{};
+    for (auto n : o.threads)
+        pools.push_back(std::make_unique<parallel::pool>(n));
+
+    auto const all = variants();
+    for (auto const & r : resolutions)
+    {
+        if (!selected(o.resolutions, r.name))
+            continue;
+
+        // Named "source>output" if "--output" differs
+        auto       output = output_of(o, r);
+        auto const name   = std::string{r.name} + (output.name == r.name ? "" : ">" + std::string{output.name});
+        output.name       = name;
+
+        auto const source = make_source(r.width, r.height);
+        auto       target = image::frame(output.width, output.height);
+
+        for (auto const & length : o.lengths)
+        {
+            for (auto const & where : placements(output, length))
+            {
+                // One reference per filter, made when first needed
+                auto expected = std::array<image::frame, 2>{};
+                for (auto const & kind : all)
+                {
+                    if (!selected(o.variants, kind.name))
+                        continue;
+
+                    auto & reference = expected[static_cast<std::size_t>(kind.filter)];
+                    if (o.tolerance >= 0 && reference.width() == 0)
+                        reference = bench::reference(source.const_view(), output, where.triangle, kind.filter);
+
+                    for (auto const level : o.isas)
+                    {
+                        cpu::force(level);
+                        for (auto & workers : pools)
+                            measure(
+                                o, kind, *workers, output, source.const_view(), target.view(), reference.const_view(),
+                                where
+                            );
+                    }
+                }
+            }
+        }
+    }
+}
+
+auto open(options const & o) -> std::unique_ptr<capture::image_source>
+{
+    if (o.source != "synthetic")
+        return std::make_unique<capture::sequence>(capture::sequence::from_directory(o.source), 0, 0, true);
+
+    auto r = resolutions[1];
+    for (auto const & candidate : resolutions)
+        if (!o.resolutions.empty() && candidate.name == o.resolutions.front())
+            r = candidate;
+
+    auto interval = std::chrono::microseconds{o.fps > 0. ? static_cast<std::int64_t>(1e6 / o.fps) : 0};
+    return std::make_unique<capture::synthetic>(r.width, r.height, interval);
+}
+
+// Pull frames from a source and render each one like the window would.
+auto stream(options const & o) -> void
+{
+    cpu::force(o.isas.front());
+    std::printf(
+        "%-24s %-11s %6s %4s %8s %8s %8s %8s %10s %10s %10s\n", "variant", "size", "length", "thr", "frames",
+        "skipped", "dirty%", "out%", "fps", "mean ms", "max ms"
+    );
+
+    for (auto const & kind : variants())
+    {
+        if (!selected(o.variants, kind.name))
+            continue;
+
+        for (auto threads : o.threads)
+        {
+            for (auto const & length : o.lengths)
+            {
+                auto workers = parallel::pool(threads);
+                auto source  = open(o);
+                auto target  = image::frame{};
+                auto check   = image::frame{};
+                auto v       = kind.create();
+                auto tracker = dirty::tracker{};
+                auto planner = schedule::scheduler{};
+
+                auto dirty = 0.;
+                auto drawn = 0.;
+                auto wrong = std::uint64_t{};
+                auto total = timer::duration::zero();
+                auto worst = timer::duration::zero();
+                auto begin = timer::now();
+                auto count = std::uint64_t{};
+                auto place = fold::aligned_regular_triangle{};
+                for (; count < o.frames; ++count)
+                {
+                    source->release();
+                    if (!source->acquire(std::chrono::milliseconds{1000}))
+                        break;
+
+                    auto const   start = timer::now();
+                    auto const & info  = source->info();
+                    if (info.width != target.width() || info.height != target.height())
+                    {
+                        target.resize(info.width, info.height);
+                        auto r = resolution{"", info.width, info.height};
+                        place  = placements(r, length).front().triangle;
+                        v.on_resize(info.width, info.height);
+                        v.on_update(place);
+                        tracker.on_resize(info.width, info.height);
+                        tracker.on_update(place);
+                        planner.on_resize(info.width, info.height);
+                        planner.on_update(place);
+                    }
+
+                    for (auto const & r : info.dirty)
+                        dirty += static_cast<double>(r.width()) * r.height() / (info.width * info.height);
+
+                    // Like the window: keep the output if nothing it shows changed
+                    planner.on_capture(info);
+                    if (!planner.on_tick())
+                    {
+                        total += timer::now() - start;
+                        continue;
+                    }
+
+                    // A variant that switched how it renders may have changed
+                    // any pixel, not just those the dirty rects reach
+                    v.on_capture(source->view());
+                    if (o.full || v.switched())
+                    {
+                        v.on_render(workers, target.view());
+                        drawn += 1.;
+                    }
+                    else
+                    {
+                        tracker.on_capture(info);
+                        v.on_render_areas(workers, target.view(), tracker.areas());
+                        drawn += static_cast<double>(tracker.pixels()) / (info.width * info.height);
+                    }
+
+                    auto const took = timer::now() - start;
+                    if (o.verify)
+                    {
+                        check.resize(info.width, info.height);
+                        v.on_render(workers, check.view());
+                        for (auto y = 0u; y < info.height; ++y)
+                            wrong += std::memcmp(target.view().row(y), check.view().row(y), info.width * 4) != 0;
+                    }
+
+                    total += took;
+                    worst = std::max(worst, took);
+                }
+                source->release();
+
+                auto const seconds = std::chrono::duration<double>(timer::now() - begin).count();
+                auto const frames  = static_cast<double>(std::max<std::uint64_t>(count, 1));
+                std::printf(
+                    "%-24.*s %5ux%-5u %6.0f %4zu %8llu %8llu %8.2f %8.2f %10.1f %10.3f %10.3f\n",
+                    static_cast<int>(kind.name.size()), kind.name.data(), target.width(), target.height(),
+                    place.length, workers.size(), static_cast<unsigned long long>(count),
+                    static_cast<unsigned long long>(planner.skipped_frames()), dirty * 100. / frames,
+                    drawn * 100. / frames, count / seconds, milliseconds(total) / frames, milliseconds(worst)
+                );
+                if (o.verify)
+                    std::printf("%llu rows differ from full renders\n", static_cast<unsigned long long>(wrong));
+                std::fflush(stdout);
+            }
+        }
+    }
+}
+// A set associative cache with least recently used replacement, which
+// counts the lines it had to fetch.
+class simulated_cache
+{
+public:
+    simulated_cache(std::size_t bytes, std::size_t ways)
+        : ways(ways)
+        , sets(bytes / image::cache_line / ways)
+        , lines(sets * ways, ~std::size_t{})
+    {}
+
+    auto touch(std::size_t address) -> void
+    {
+        auto const line  = address / image::cache_line;
+        auto const first = lines.begin() + static_cast<std::ptrdiff_t>(line % sets * ways);
+        auto const last  = first + static_cast<std::ptrdiff_t>(ways);
+        auto       found = std::find(first, last, line);
+        if (found == last)
+        {
+            ++count;
+            found = last - 1;
+        }
+
+        // Most recently used first
+        std::rotate(first, found, found + 1);
+        *first = line;
+    }
+
+    auto misses() const -> std::uint64_t
+    {
+        return count;
+    }
+
+private:
+    std::size_t              ways;
+    std::size_t              sets;
+    std::vector<std::size_t> lines;
+    std::uint64_t            count{};
+};
+
+// Replay the source reads of one frame through "simulated_cache", which
+// compares layouts of the patch by what they cost in cache misses, not in
+// time, so that it is the same on every machine.
+auto misses(options const & o) -> void
+{
+    std::printf(
+        "%-24s %-6s %6s %-12s %12s %12s\n", "variant", "res", "length", "position", "L1 miss/px", "L2 miss/px"
+    );
+
+    auto const all = variants();
+    for (auto const & r : resolutions)
+    {
+        if (!selected(o.resolutions, r.name))
+            continue;
+
+        auto const source = make_source(r.width, r.height);
+        for (auto const & length : o.lengths)
+        {
+            for (auto const & where : placements(r, length))
+            {
+                for (auto const & kind : all)
+                {
+                    if (!selected(o.variants, kind.name))
+                        continue;
+
+                    auto v = kind.create();
+                    if (!v.trace)
+                        continue;
+
+                    v.on_resize(r.width, r.height);
+                    v.on_update(where.triangle);
+                    v.on_capture(source.const_view());
+
+                    auto l1 = simulated_cache(32 << 10, 8);
+                    auto l2 = simulated_cache(1 << 20, 16);
+                    v.trace([&](std::size_t address) { l1.touch(address), l2.touch(address); });
+
+                    auto const pixels = static_cast<double>(r.width) * r.height;
+                    std::printf(
+                        "%-24.*s %-6.*s %6.0f %-12.*s %12.4f %12.4f\n", static_cast<int>(kind.name.size()),
+                        kind.name.data(), static_cast<int>(r.name.size()), r.name.data(), where.triangle.length,
+                        static_cast<int>(where.name.size()), where.name.data(), l1.misses() / pixels,
+                        l2.misses() / pixels
+                    );
+                    std::fflush(stdout);
+                }
+            }
+        }
+    }
+}
+
+// Turn the wheel like "viewmodel::state::on_length_changed" does and time the
+// frame after every notch.
+auto zoom(options const & o) -> void
+{
+    cpu::force(o.isas.front());
+    std::printf(
+        "%-24s %-6s %-8s %4s %8s %6s %6s %10s %10s %10s\n", "variant", "res", "prebuild", "thr", "notches", "from",
+        "to", "mean ms", "median ms", "max ms"
+    );
+
+    for (auto const & r : resolutions)
+    {
+        if (!selected(o.resolutions, r.name))
+            continue;
+
+        auto const source = make_source(r.width, r.height);
+        auto       target = image::frame(r.width, r.height);
+        for (auto threads : o.threads)
+        {
+            for (auto const is_ahead : {false, true})
+            {
+                auto const directory = std::filesystem::temp_directory_path() / "kaleidoscope_zoom";
+                auto       ignored   = std::error_code{};
+                std::filesystem::remove_all(directory, ignored);
+
+                auto const cache   = std::make_shared<tiles::cache>(directory);
+                auto       map     = engine::fold_map{staging::mode::crop, sample::filter::linear, cache};
+                auto       workers = parallel::pool(threads);
+                auto       place   = placements(r, "32").front().triangle;
+                auto const longest = static_cast<std::uint32_t>(
+                    std::floor(max_length(r.width, r.height, place.top_x, place.top_y))
+                );
+                auto const prepare = [&](std::uint32_t length)
+                { engine::fold_map::prepare(cache, r.width, r.height, length); };
+                auto ahead = is_ahead ? std::make_unique<wheel::prebuilder>(prepare) : nullptr;
+
+                map.on_resize(r.width, r.height);
+                map.on_update(place);
+                map.on_capture(source.const_view());
+                parallel::render(workers, map, target.view());
+
+                auto const gap   = std::chrono::duration<double, std::milli>{o.notch};
+                auto const from  = place.length;
+                auto const begin = timer::now();
+                auto       times = std::vector<timer::duration>{};
+                for (auto i = 0u; i < o.notches; ++i)
+                {
+                    std::this_thread::sleep_until(begin + std::chrono::duration_cast<timer::duration>(gap * i));
+                    auto const now    = timer::now();
+                    auto const factor = i == 0 ? 1 : wheel::step(now - begin);
+                    place.length      = std::clamp(place.length + factor, 8.f, static_cast<float>(longest));
+                    if (ahead != nullptr)
+                        ahead->on_zoom(1, static_cast<std::uint32_t>(place.length), longest, now);
+
+                    auto const start = timer::now();
+                    map.on_update(place);
+                    map.on_capture(source.const_view());
+                    parallel::render(workers, map, target.view());
+                    times.push_back(timer::now() - start);
+                }
+                ahead.reset();
+                std::filesystem::remove_all(directory, ignored);
+
+                auto total = timer::duration::zero();
+                for (auto took : times)
+                    total += took;
+                std::sort(times.begin(), times.end());
+                std::printf(
+                    "%-24s %-6.*s %-8s %4zu %8u %6.0f %6.0f %10.3f %10.3f %10.3f\n", "fold_map/tiles",
+                    static_cast<int>(r.name.size()), r.name.data(),
+                    is_ahead ? "yes" : "no", workers.size(), o.notches, from, place.length,
+                    milliseconds(total) / times.size(), milliseconds(times[times.size() / 2]),
+                    milliseconds(times.back())
+                );
+                std::fflush(stdout);
+            }
+        }
+    }
+}
+
+// Milliseconds of the first "frame", which builds the tables, and of the
+// fastest one after it.
+template <typename F> auto fastest(options const & o, F && frame) -> std::pair<double, double>
+{
+    auto const begin = timer::now();
+    frame();
+    auto const setup = timer::now() - begin;
+
+    auto best  = timer::duration::max();
+    auto spent = timer::duration::zero();
+    for (auto count = 0; count < 3 || milliseconds(spent) < o.seconds * 1000.; ++count)
+    {
+        auto const start = timer::now();
+        frame();
+        auto const took = timer::now() - start;
+        best            = std::min(best, took);
+        spent += took;
+    }
+    return {milliseconds(setup), milliseconds(best)};
+}
+
+// Stage "i" of a stack: the triangle of "first" shrunk by 0.6 per stage,
+// and moved down so that it stays inside.
+auto stage(fold::aligned_regular_triangle const & first, std::uint32_t i) -> fold::aligned_regular_triangle
+{
+    auto const length = std::floor(first.length * std::pow(.6f, static_cast<float>(i)));
+    auto const drop   = std::floor((first.length - length) * fold::half_sqrt3 * .5f);
+    return {first.top_x, first.top_y + drop, std::max(length, 8.f)};
+}
+
+// Put back the inside of "t" from "below", where a pass left it transparent
+// for the screen to show through.
+auto composite(fold::aligned_regular_triangle const & t, image::const_view below, image::view target) -> void
+{
+    auto const triangle = fold::normalize(t, target.width, target.height);
+    auto const corners  = fold::corners(triangle);
+    auto const box      = staging::bounds(t, 1., 1.);
+    auto const clip     = [](std::int64_t v, std::uint32_t size)
+    { return static_cast<std::uint32_t>(std::clamp<std::int64_t>(v, 0, size)); };
+    for (auto y = clip(box.top, target.height); y < clip(std::int64_t{box.top} + box.height, target.height); ++y)
+        for (auto x = clip(box.left, target.width); x < clip(std::int64_t{box.left} + box.width, target.width); ++x)
+            if (fold::is_inside(corners, fold::texcoord(x, y, target.width, target.height)))
+                target.at(x, y) = below.row(y)[x];
+}
+
+// Render a stack of kaleidoscopes both pass by pass and in one table.
+auto stack(options const & o) -> void
+{
+    cpu::force(o.isas.front());
+    std::printf(
+        "%-24s %-6s %6s %6s %4s %10s %10s %10s %4s\n", "variant", "res", "length", "stages", "thr", "setup ms",
+        "frame ms", "buffers MB", "err"
+    );
+
+    for (auto const & r : resolutions)
+    {
+        if (!selected(o.resolutions, r.name))
+            continue;
+
+        auto const source = make_source(r.width, r.height);
+        auto       fused  = image::frame(r.width, r.height);
+        auto       frames = std::vector<image::frame>{};
+        for (auto i = 0u; i < o.stages; ++i)
+            frames.emplace_back(r.width, r.height);
+
+        for (auto const & length : o.lengths)
+        {
+            auto const first     = placements(r, length).front().triangle;
+            auto       triangles = std::vector<fold::aligned_regular_triangle>{};
+            for (auto i = 0u; i < o.stages; ++i)
+                triangles.push_back(stage(first, i));
+
+            for (auto threads : o.threads)
+            {
+                auto workers = parallel::pool(threads);
+                auto passes = std::vector<std::unique_ptr<engine::fold_map>>{};
+                for (auto const & t : triangles)
+                {
+                    passes.push_back(std::make_unique<engine::fold_map>(staging::mode::crop));
+                    passes.back()->on_resize(r.width, r.height);
+                    passes.back()->on_update(t);
+                }
+                auto const passed = fastest(
+                    o,
+                    [&]
+                    {
+                        auto below = source.const_view();
+                        for (auto i = 0u; i < o.stages; ++i)
+                        {
+                            passes[i]->on_capture(below);
+                            parallel::render(workers, *passes[i], frames[i].view());
+                            if (i + 1 < o.stages)
+                                composite(triangles[i], below, frames[i].view());
+                            below = frames[i].const_view();
+                        }
+                    }
+                );
+
+                auto map = engine::fold_map{staging::mode::crop};
+                map.on_resize(r.width, r.height);
+                map.on_update(triangles);
+                auto const stacked = fastest(
+                    o,
+                    [&]
+                    {
+                        map.on_capture(source.const_view());
+                        parallel::render(workers, map, fused.view());
+                    }
+                );
+
+                auto const bytes  = static_cast<double>(r.width) * r.height * sizeof(image::pixel);
+                auto       tables = 0.;
+                for (auto const & pass : passes)
+                    tables += static_cast<double>(pass->footprint());
+
+                auto const off  = std::to_string(difference(fused.const_view(), frames.back().const_view()));
+                auto const line =
+                    [&](char const * name, std::pair<double, double> took, double buffers, char const * err)
+                {
+                    std::printf(
+                        "%-24s %-6.*s %6.0f %6u %4zu %10.3f %10.3f %10.1f %4s\n", name,
+                        static_cast<int>(r.name.size()), r.name.data(), first.length, o.stages, workers.size(),
+                        took.first, took.second, buffers / 1e6, err
+                    );
+                };
+                line("fold_map/passes", passed, tables + bytes * (o.stages - 1), "-");
+                line("fold_map/stacked", stacked, static_cast<double>(map.footprint()), off.c_str());
+                std::fflush(stdout);
+            }
+        }
+    }
+}
+
+// Render thumbnails of one frame with one engine going through them, and
+// with a gallery.
+auto gallery(options const & o) -> void
+{
+    cpu::force(o.isas.front());
+    std::printf(
+        "%-24s %-6s %-9s %6s %4s %10s %10s %4s\n", "variant", "res", "size", "thumbs", "thr", "setup ms", "frame ms",
+        "err"
+    );
+
+    for (auto const & r : resolutions)
+    {
+        if (!selected(o.resolutions, r.name))
+            continue;
+
+        // Spread by the golden ratio, growing up to the longest that fits
+        auto const source   = make_source(r.width, r.height);
+        auto const w        = r.width / 4;
+        auto const h        = r.height / 4;
+        auto       each     = std::vector<image::frame>{};
+        auto       all      = std::vector<image::frame>{};
+        auto       expected = std::vector<image::frame>{};
+        auto       items    = std::vector<engine::gallery::item>{};
+        for (auto i = 0u; i < o.thumbnails; ++i)
+        {
+            auto const u       = std::fmod(i * .618, 1.);
+            auto const v       = std::fmod(i * .414, 1.);
+            auto const top_x   = std::floor(w * (.2 + .6 * u));
+            auto const top_y   = std::floor(h * (.1 + .4 * v));
+            auto const longest = max_length(w, h, top_x, top_y);
+            auto const length  = std::floor(8. + (longest - 8.) * (i + 1) / o.thumbnails);
+            each.emplace_back(w, h);
+            all.emplace_back(w, h);
+            expected.emplace_back(w, h);
+            items.push_back({{static_cast<float>(top_x), static_cast<float>(top_y), static_cast<float>(length)}, {}});
+        }
+        for (auto i = 0u; i < o.thumbnails; ++i)
+            items[i].target = all[i].view();
+
+        for (auto threads : o.threads)
+        {
+            auto       workers = parallel::pool(threads);
+            auto const size    = std::to_string(w) + "x" + std::to_string(h);
+            auto const line    = [&](char const * name, std::pair<double, double> took, std::string const & err)
+            {
+                std::printf(
+                    "%-24s %-6.*s %-9s %6u %4zu %10.3f %10.3f %4s\n", name, static_cast<int>(r.name.size()),
+                    r.name.data(), size.c_str(), o.thumbnails, workers.size(), took.first, took.second, err.c_str()
+                );
+            };
+
+            // One engine going through all thumbnails, every frame
+            auto const looped = [&](auto & e, std::vector<image::frame> & into)
+            {
+                return fastest(
+                    o,
+                    [&]
+                    {
+                        for (auto i = 0u; i < o.thumbnails; ++i)
+                        {
+                            e.on_resize(w, h);
+                            e.on_update(items[i].triangle);
+                            e.on_capture(source.const_view());
+                            parallel::render(workers, e, into[i].view());
+                        }
+                    }
+                );
+            };
+            auto const off = [&](std::vector<image::frame> const & frames)
+            {
+                auto most = 0;
+                for (auto i = 0u; i < o.thumbnails; ++i)
+                    most = std::max(most, difference(frames[i].const_view(), expected[i].const_view()));
+                return std::to_string(most);
+            };
+
+            auto reference = engine::direct{};
+            line("direct", looped(reference, expected), "-");
+
+            auto       one    = engine::scanline{};
+            auto const stream = looped(one, each);
+            line("scanline", stream, off(each));
+
+            auto batch = engine::gallery{};
+            batch.on_update(items);
+            auto const took = fastest(
+                o,
+                [&]
+                {
+                    batch.on_capture(workers, source.const_view());
+                    batch.on_render(workers);
+                }
+            );
+            line("gallery", took, off(all));
+            std::fflush(stdout);
+        }
+    }
+}
+
+// Render every frame together with smaller copies of it, three ways.
+auto preview(options const & o) -> void
+{
+    cpu::force(o.isas.front());
+    std::printf(
+        "%-24s %-6s %6s %-10s %4s %10s %10s %10s %4s\n", "variant", "res", "length", "previews", "thr", "second ms",
+        "after ms", "fused ms", "err"
+    );
+
+    auto names = std::string{};
+    for (auto n : o.shrink)
+        names += (names.empty() ? "1/" : ",1/") + std::to_string(n);
+
+    for (auto const & r : resolutions)
+    {
+        if (!selected(o.resolutions, r.name))
+            continue;
+
+        auto const source = make_source(r.width, r.height);
+        auto       target = image::frame(r.width, r.height);
+        auto       after  = std::vector<image::frame>{};
+        auto       fused  = std::vector<image::frame>{};
+        for (auto n : o.shrink)
+        {
+            after.emplace_back(r.width / n, r.height / n);
+            fused.emplace_back(r.width / n, r.height / n);
+        }
+        auto views = std::vector<image::view>{};
+        for (auto const & f : fused)
+            views.push_back(f.view());
+
+        for (auto const & kind : variants())
+        {
+            if (!selected(o.variants, kind.name))
+                continue;
+
+            for (auto const & length : o.lengths)
+            {
+                auto const triangle = placements(r, length).front().triangle;
+                for (auto threads : o.threads)
+                {
+                    auto workers = parallel::pool(threads);
+                    auto full    = kind.create();
+                    full.on_resize(r.width, r.height);
+                    full.on_update(triangle);
+
+                    // The triangle at the same place of each copy
+                    auto seconds = std::vector<instance>{};
+                    for (auto k = std::size_t{}; k < o.shrink.size(); ++k)
+                    {
+                        auto const n     = static_cast<float>(o.shrink[k]);
+                        auto       small = triangle;
+                        small.top_x /= n;
+                        small.top_y /= n;
+                        small.length /= n;
+                        seconds.push_back(kind.create());
+                        seconds.back().on_resize(after[k].width(), after[k].height());
+                        seconds.back().on_update(small);
+                    }
+
+                    auto const second = fastest(
+                        o,
+                        [&]
+                        {
+                            full.on_capture(source.const_view());
+                            full.on_render(workers, target.view());
+                            for (auto k = std::size_t{}; k < seconds.size(); ++k)
+                            {
+                                seconds[k].on_capture(source.const_view());
+                                seconds[k].on_render(workers, after[k].view());
+                            }
+                        }
+                    );
+
+                    auto const reduced = fastest(
+                        o,
+                        [&]
+                        {
+                            full.on_capture(source.const_view());
+                            full.on_render(workers, target.view());
+                            for (auto & small : after)
+                                workers.run(
+                                    small.height(),
+                                    [&](std::size_t y)
+                                    {
+                                        previews::reduce_row(
+                                            target.const_view(), small.view(), static_cast<std::uint32_t>(y)
+                                        );
+                                    }
+                                );
+                        }
+                    );
+
+                    auto const together = fastest(
+                        o,
+                        [&]
+                        {
+                            full.on_capture(source.const_view());
+                            full.on_render_previews(workers, target.view(), views);
+                        }
+                    );
+
+                    auto off = 0;
+                    for (auto k = std::size_t{}; k < after.size(); ++k)
+                        off = std::max(off, difference(after[k].const_view(), fused[k].const_view()));
+                    std::printf(
+                        "%-24.*s %-6.*s %6.0f %-10s %4zu %10.3f %10.3f %10.3f %4d\n",
+                        static_cast<int>(kind.name.size()), kind.name.data(), static_cast<int>(r.name.size()),
+                        r.name.data(), triangle.length, names.c_str(), workers.size(), second.second, reduced.second,
+                        together.second, off
+                    );
+                    std::fflush(stdout);
+                }
+            }
+        }
+    }
+}
+
+// Largest differences of a luma and of a chroma value between two frames of
+// the same size.
+auto difference(yuv::const_view a, yuv::const_view b) -> std::pair<int, int>
+{
+    auto const most = [](std::uint8_t const * p, std::uint8_t const * q, std::uint32_t count, std::uint32_t step)
+    {
+        auto off = 0;
+        for (auto i = 0u; i < count; ++i)
+            off = std::max(off, std::abs(static_cast<int>(p[i * step]) - static_cast<int>(q[i * step])));
+        return off;
+    };
+
+    auto out = std::pair<int, int>{};
+    for (auto y = 0u; y < a.height; ++y)
+        out.first = std::max(out.first, most(a.y + y * a.y_stride, b.y + y * b.y_stride, a.width, 1));
+    for (auto y = 0u; y < a.chroma_height(); ++y)
+    {
+        auto const at = [&](yuv::const_view f, std::uint8_t const * plane) { return plane + y * f.uv_stride; };
+        out.second    = std::max(out.second, most(at(a, a.u), at(b, b.u), a.chroma_width(), a.step));
+        out.second    = std::max(out.second, most(at(a, a.v), at(b, b.v), a.chroma_width(), a.step));
+    }
+    return out;
+}
+
+// Render every frame in YUV, by converting a BGRA frame and directly.
+auto planar(options const & o) -> void
+{
+    cpu::force(o.isas.front());
+    if (o.yuv != "nv12" && o.yuv != "i420")
+        throw std::invalid_argument("unknown format " + o.yuv);
+
+    auto const layout = o.yuv == "nv12" ? yuv::format::nv12 : yuv::format::i420;
+    std::printf(
+        "%-10s %6s %4s %4s %10s %10s %10s %10s %6s %6s %10s %10s\n", "res", "length", "fmt", "thr", "render ms",
+        "convert ms", "planar ms", "yuv src ms", "y err", "uv err", "drag 1 ms", "drag 2 ms"
+    );
+
+    for (auto const & r : resolutions)
+    {
+        if (!selected(o.resolutions, r.name))
+            continue;
+
+        auto const output    = output_of(o, r);
+        auto const source    = make_source(r.width, r.height);
+        auto const converted = [&]
+        {
+            auto out = yuv::frame(layout, r.width, r.height);
+            yuv::convert(source.const_view(), out.view(), 0, r.height);
+            return out;
+        }();
+        auto rendered = image::frame(output.width, output.height);
+        auto after    = yuv::frame(layout, output.width, output.height);
+        auto direct   = yuv::frame(layout, output.width, output.height);
+        auto decoded  = yuv::frame(layout, output.width, output.height);
+        auto label    = std::string{r.name};
+        if (output.name != r.name)
+            label += ">" + std::string{output.name};
+
+        for (auto const & length : o.lengths)
+        {
+            auto const triangle = placements(output, length).front().triangle;
+            for (auto threads : o.threads)
+            {
+                auto workers = parallel::pool(threads);
+                auto map     = engine::fold_map{staging::mode::crop};
+                map.on_cut(false);
+                map.on_resize(output.width, output.height);
+                map.on_update(triangle);
+
+                auto const band    = 16u;
+                auto const bands   = (output.height + band - 1) / band;
+                auto const convert = [&]
+                {
+                    workers.run(
+                        bands,
+                        [&](std::size_t index)
+                        {
+                            auto const top = static_cast<std::uint32_t>(index) * band;
+                            yuv::convert(rendered.const_view(), after.view(), top, top + band);
+                        }
+                    );
+                };
+                auto const render = fastest(
+                    o,
+                    [&]
+                    {
+                        map.on_capture(source.const_view());
+                        parallel::render(workers, map, rendered.view());
+                    }
+                );
+                auto const conversion = fastest(o, convert);
+
+                auto e = engine::planar{};
+                e.on_resize(output.width, output.height);
+                e.on_update(triangle);
+                auto const folded = fastest(
+                    o,
+                    [&]
+                    {
+                        e.on_capture(source.const_view());
+                        e.on_render(workers, direct.view());
+                    }
+                );
+
+                auto const from_yuv = fastest(
+                    o,
+                    [&]
+                    {
+                        e.on_capture(converted.const_view());
+                        e.on_render(workers, decoded.view());
+                    }
+                );
+
+                auto const [luma, chroma] = difference(after.const_view(), direct.const_view());
+
+                // Away and back, diagonally
+                auto const drag = [&](float step)
+                {
+                    auto spent = timer::duration::zero();
+                    for (auto d : {step, 0.f})
+                    {
+                        e.on_update({triangle.top_x + d, triangle.top_y + d, triangle.length});
+                        auto start = timer::now();
+                        e.on_capture(source.const_view());
+                        e.on_render(workers, direct.view());
+                        spent += (timer::now() - start) / 2;
+                    }
+                    return milliseconds(spent);
+                };
+                drag(1.f); // makes the table of the odd phase
+                auto const odd  = drag(1.f);
+                auto const even = drag(2.f);
+
+                std::printf(
+                    "%-10s %6.0f %4s %4zu %10.3f %10.3f %10.3f %10.3f %6d %6d %10.3f %10.3f\n", label.c_str(),
+                    triangle.length, o.yuv.c_str(), workers.size(), render.second, conversion.second, folded.second,
+                    from_yuv.second, luma, chroma, odd, even
+                );
+                std::fflush(stdout);
+            }
+        }
+    }
+}
+} // namespace bench
+
+auto main(int argc, char ** argv) -> int
+{
+    try
+    {
+        auto const o = bench::parse(argc, argv);
+        if (o.misses)
+            bench::misses(o);
+        else if (o.notches > 0)
+            bench::zoom(o);
+        else if (o.stages > 0)
+            bench::stack(o);
+        else if (o.thumbnails > 0)
+            bench::gallery(o);
+        else if (!o.shrink.empty())
+            bench::preview(o);
+        else if (!o.yuv.empty())
+            bench::planar(o);
+        else if (o.source.empty())
+            bench::run(o);
+        else
+            bench::stream(o);
+        return 0;
+    }
+    catch (std::exception const & e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,208 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KALEIDOSCOPE_X86 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+// GCC 12 warns about the deliberately undefined values inside its AVX-512
+// intrinsics (its bug 105593), wherever they are inlined.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#else
+#include <immintrin.h>
+#endif
+#endif
+
+// Instruction sets of single functions, so that one binary carries a build
+// of each kernel for every level below and picks one at run time.
+//
+// GCC and Clang compile a function marked with "KALEIDOSCOPE_TARGET_*" for
+// that level, including whatever "KALEIDOSCOPE_INLINE" code it calls. MSVC
+// accepts every intrinsic without flags but never vectorizes beyond its
+// "/arch", so there the levels only differ in their hand-written parts.
+//
+// FMA is left out on purpose: fused multiply-adds round differently, and
+// every level has to produce the same bytes as "kernel::direct". AVX-512F
+// implies FMA, and GCC turns it on even after "no-fma", so the core is built
+// with "-ffp-contract=off" (see its CMakeLists.txt) to keep the compiler from
+// fusing the float math of those builds.
+#if defined(KALEIDOSCOPE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define KALEIDOSCOPE_TARGET_SSE42  __attribute__((target("sse4.2,popcnt")))
+#define KALEIDOSCOPE_TARGET_AVX2   __attribute__((target("sse4.2,popcnt,avx2,bmi,bmi2")))
+#define KALEIDOSCOPE_TARGET_AVX512 __attribute__((target("sse4.2,popcnt,avx2,bmi,bmi2,avx512f,avx512bw,avx512vl")))
+#else
+#define KALEIDOSCOPE_TARGET_SSE42
+#define KALEIDOSCOPE_TARGET_AVX2
+#define KALEIDOSCOPE_TARGET_AVX512
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define KALEIDOSCOPE_INLINE __forceinline
+#else
+#define KALEIDOSCOPE_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace cpu
+{
+
+// Levels of x86-64 the kernels are built for, in order. Other processors
+// only ever run "baseline".
+enum class isa
+{
+    baseline, // SSE2, part of every x86-64
+    sse42,
+    avx2,
+    avx512, // F, BW and VL
+};
+
+auto inline constexpr isas = std::array<isa, 4>{isa::baseline, isa::sse42, isa::avx2, isa::avx512};
+
+auto inline constexpr name(isa level) -> std::string_view
+{
+    switch (level)
+    {
+    case isa::sse42:
+        return "sse4.2";
+    case isa::avx2:
+        return "avx2";
+    case isa::avx512:
+        return "avx512";
+    default:
+        return "baseline";
+    }
+}
+
+auto inline parse(std::string_view text) -> std::optional<isa>
+{
+    for (auto level : isas)
+        if (name(level) == text)
+            return level;
+    return std::nullopt;
+}
+
+// The best level this processor and OS support, by cpuid and xgetbv.
+auto inline detect() -> isa
+{
+#ifdef KALEIDOSCOPE_X86
+    auto const cpuid = [](unsigned leaf, unsigned subleaf) -> std::array<unsigned, 4>
+    {
+        auto out = std::array<unsigned, 4>{};
+#ifdef _MSC_VER
+        auto regs = std::array<int, 4>{};
+        __cpuidex(regs.data(), static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (auto i = 0; i < 4; ++i)
+            out[i] = static_cast<unsigned>(regs[i]);
+#else
+        if (leaf > __get_cpuid_max(0, nullptr))
+            return out;
+        __cpuid_count(leaf, subleaf, out[0], out[1], out[2], out[3]);
+#endif
+        return out;
+    };
+
+    // Register state the OS saves on context switches
+    auto const xgetbv = []() -> std::uint64_t
+    {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        auto low = 0u, high = 0u;
+        __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+        return (std::uint64_t{high} << 32) | low;
+#endif
+    };
+
+    auto const bit     = [](unsigned reg, int n) { return ((reg >> n) & 1u) != 0; };
+    auto const basic   = cpuid(1, 0);
+    auto const sse42   = bit(basic[2], 20) && bit(basic[2], 23); // SSE4.2, POPCNT
+    auto const osxsave = bit(basic[2], 27);
+    auto const avx     = bit(basic[2], 28);
+    if (!sse42)
+        return isa::baseline;
+    if (!osxsave || !avx)
+        return isa::sse42;
+
+    auto const state    = xgetbv();
+    auto const extended = cpuid(7, 0);
+    auto const ymm      = (state & 0x06) == 0x06;
+    auto const zmm      = (state & 0xe6) == 0xe6;
+    auto const avx2     = bit(extended[1], 5) && bit(extended[1], 3) && bit(extended[1], 8); // AVX2, BMI1, BMI2
+    auto const avx512   = bit(extended[1], 16) && bit(extended[1], 30) && bit(extended[1], 31); // F, BW, VL
+    if (!ymm || !avx2)
+        return isa::sse42;
+    if (!zmm || !avx512)
+        return isa::avx2;
+    return isa::avx512;
+#else
+    return isa::baseline;
+#endif
+}
+
+auto inline supports(isa level) -> bool
+{
+    auto static const best = detect();
+    return level <= best;
+}
+
+namespace state
+{
+auto inline selection() -> std::atomic<isa> &
+{
+    auto static level = std::atomic<isa>{detect()};
+    return level;
+}
+} // namespace state
+
+// Level the kernels run at: the detected one, unless forced.
+auto inline active() -> isa
+{
+    return state::selection().load(std::memory_order_relaxed);
+}
+
+// Run the kernels at "level" from now on, e.g. to compare levels on one
+// machine. Only levels the processor supports are accepted.
+auto inline force(isa level) -> void
+{
+    if (!supports(level))
+        throw std::invalid_argument("this processor doesn't support " + std::string{name(level)});
+
+    state::selection().store(level, std::memory_order_relaxed);
+}
+
+// One build of a kernel per level. "pick" returns the one to run.
+template <typename F> struct variants
+{
+    F baseline;
+    F sse42;
+    F avx2;
+    F avx512;
+
+    auto pick() const -> F
+    {
+        switch (active())
+        {
+        case isa::sse42:
+            return sse42;
+        case isa::avx2:
+            return avx2;
+        case isa::avx512:
+            return avx512;
+        default:
+            return baseline;
+        }
+    }
+};
+} // namespace cpu
@@ -0,0 +1,227 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "direct.h"
+#include "fold.h"
+#include "fold_map.h"
+#include "image.h"
+#include "patch.h"
+#include "sample.h"
+#include "tile_cache.h"
+
+namespace engine
+{
+
+// "fold_map" with its table made on a thread of its own.
+//
+// Until the table for the current sizes and length is ready, frames are
+// rendered by "direct", which needs no setup, so neither the first frame nor
+// the ones after a resize or a zoom wait for a table. Once the thread is
+// done, "on_capture" takes the table over, so a frame is rendered by either
+// one or the other, never a mix of both.
+//
+// In the crop modes a move by whole source texels keeps the table, which
+// "fold_map" shifts along in a fraction of a build; any other move rebuilds
+// it on the calling thread. With "staging::mode::full" the table can't
+// follow, so a move asks the thread for a table at the new position, and
+// "direct" renders until it is there, which during a drag is every frame.
+//
+// The two don't round every pixel the same way, see "fold_map", so a caller
+// that renders only the dirty areas of a frame has to render all of it
+// after "switched".
+class deferred
+{
+public:
+    explicit deferred(
+        staging::mode how = staging::mode::full, sample::filter filter = sample::filter::linear,
+        std::shared_ptr<tiles::cache> cache = nullptr
+    )
+        : how(how)
+        , filter(filter)
+        , cache(std::move(cache))
+        , fallback(how, filter)
+        , worker([this](std::stop_token token) { serve(token); })
+    {}
+
+    ~deferred()
+    {
+        worker.request_stop();
+        {
+            auto guard = std::lock_guard{lock};
+            is_asked   = false;
+        }
+        wakeup.notify_all();
+    }
+
+    deferred(deferred const &)             = delete;
+    deferred & operator=(deferred const &) = delete;
+
+    auto on_resize(std::uint32_t width, std::uint32_t height) -> void
+    {
+        output_width  = width;
+        output_height = height;
+        fallback.on_resize(width, height);
+    }
+
+    auto on_update(fold::aligned_regular_triangle const & triangle) -> void
+    {
+        current = triangle;
+        fallback.on_update(triangle);
+    }
+
+    auto on_capture(image::const_view source) -> void
+    {
+        auto wanted = layout{output_width, output_height, source.width, source.height, source.stride, current.length};
+        if (!staging::is_cropped(how))
+        {
+            wanted.top_x = current.top_x;
+            wanted.top_y = current.top_y;
+        }
+
+        if (table == nullptr || table_for != wanted)
+        {
+            auto is_new = false;
+            {
+                auto guard = std::lock_guard{lock};
+                if (done != nullptr && done_for == wanted)
+                {
+                    table     = std::move(done);
+                    table_for = wanted;
+                }
+                else if (asked_for != wanted)
+                {
+                    done      = nullptr;
+                    job       = {wanted, current};
+                    asked_for = wanted;
+                    is_asked  = true;
+                    is_new    = true;
+                }
+            }
+            if (is_new)
+                wakeup.notify_one();
+        }
+
+        auto const was_table = is_table;
+        is_table             = table != nullptr && table_for == wanted;
+        is_switched          = is_table != was_table;
+        if (is_table)
+        {
+            table->on_update(current);
+            table->on_capture(source);
+        }
+        else
+        {
+            fallback.on_capture(source);
+        }
+    }
+
+    auto on_render(image::view target, image::rect const & area) const -> void
+    {
+        if (is_table)
+            table->on_render(target, area);
+        else
+            fallback.on_render(target, area);
+    }
+
+    auto on_render(image::view target) const -> void
+    {
+        on_render(target, target.bounds());
+    }
+
+    // Whether the last "on_capture" went from "direct" to the table, or back.
+    auto switched() const -> bool
+    {
+        return is_switched;
+    }
+
+    // Bytes of the table in use, for diagnostics.
+    auto footprint() const -> std::size_t
+    {
+        return is_table ? table->footprint() : 0;
+    }
+
+private:
+    // What a table depends on, and where the triangle is if the table can't
+    // follow it there.
+    struct layout
+    {
+        std::uint32_t output_width{};
+        std::uint32_t output_height{};
+        std::uint32_t source_width{};
+        std::uint32_t source_height{};
+        std::size_t   source_stride{};
+        float         length{};
+        float         top_x{};
+        float         top_y{};
+
+        auto operator==(layout const &) const -> bool = default;
+    };
+
+    struct request
+    {
+        layout                         shape{};
+        fold::aligned_regular_triangle triangle{};
+    };
+
+    auto serve(std::stop_token token) -> void
+    {
+        while (true)
+        {
+            auto next = request{};
+            {
+                auto guard = std::unique_lock{lock};
+                wakeup.wait(guard, [&] { return is_asked || token.stop_requested(); });
+                if (token.stop_requested())
+                    return;
+
+                next     = job;
+                is_asked = false;
+            }
+
+            auto const & shape = next.shape;
+            auto         map   = std::make_unique<fold_map>(how, filter, cache);
+            map->on_resize(shape.output_width, shape.output_height);
+            map->on_update(next.triangle);
+            map->build(shape.source_width, shape.source_height, shape.source_stride);
+
+            auto guard = std::lock_guard{lock};
+            done       = std::move(map);
+            done_for   = shape;
+        }
+    }
+
+private:
+    // Inputs
+    staging::mode                  how;
+    sample::filter                 filter;
+    std::shared_ptr<tiles::cache>  cache;
+    fold::aligned_regular_triangle current{};
+    std::uint32_t                  output_width{};
+    std::uint32_t                  output_height{};
+
+    // Rendering, by the frame's thread only
+    direct                    fallback;
+    std::unique_ptr<fold_map> table{};
+    layout                    table_for{};
+    bool                      is_table{};
+    bool                      is_switched{};
+
+    // Handed between the frame's thread and the worker
+    std::mutex                lock{};
+    std::condition_variable   wakeup{};
+    request                   job{};
+    layout                    asked_for{};
+    bool                      is_asked{};
+    std::unique_ptr<fold_map> done{};
+    layout                    done_for{};
+
+    // Last, so that it stops before the members it uses are destroyed
+    std::jthread worker;
+};
+} // namespace engine
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+
+#include "fold.h"
+#include "image.h"
+#include "kernel.h"
+#include "patch.h"
+#include "sample.h"
+
+namespace engine
+{
+
+// "kernel::direct" behind the same hooks as the other engines: the shader's
+// fold evaluated for every pixel, every frame. The reference all other
+// engines are compared against.
+//
+// With "staging::mode::crop" only the triangle's bounding box is copied out
+// of each frame, and the kernel samples that patch instead of the screen.
+// "sample::filter::point" is the reference of the nearest sampling mode.
+class direct
+{
+public:
+    explicit direct(staging::mode how = staging::mode::full, sample::filter filter = sample::filter::linear)
+        : how(how)
+        , filter(filter)
+    {}
+
+    auto on_resize(std::uint32_t width, std::uint32_t height) -> void
+    {
+        output_width  = width;
+        output_height = height;
+        triangle      = fold::normalize(current, output_width, output_height);
+        is_stale      = true;
+    }
+
+    auto on_update(fold::aligned_regular_triangle const & t) -> void
+    {
+        current  = t;
+        triangle = fold::normalize(current, output_width, output_height);
+        is_stale = true;
+    }
+
+    auto on_capture(image::const_view source) -> void
+    {
+        if (how == staging::mode::full)
+        {
+            screenshot = sample::whole(source);
+            return;
+        }
+
+        if (source.width != screenshot.width || source.height != screenshot.height)
+            is_stale = true;
+
+        if (is_stale && output_width != 0 && output_height != 0)
+        {
+            auto const scale_x = static_cast<double>(source.width) / output_width;
+            auto const scale_y = static_cast<double>(source.height) / output_height;
+            crop.on_update(current, scale_x, scale_y);
+            is_stale = false;
+        }
+
+        crop.on_capture(source);
+        screenshot = crop.window(source.width, source.height);
+    }
+
+    auto on_render(image::view target, image::rect const & area) const -> void
+    {
+        auto const output = image::rect{0, 0, output_width, output_height};
+        kernel::direct(triangle, screenshot, target, image::intersect(area, output), filter);
+    }
+
+    auto on_render(image::view target) const -> void
+    {
+        on_render(target, target.bounds());
+    }
+
+private:
+    staging::mode                  how;
+    sample::filter                 filter;
+    fold::aligned_regular_triangle current{};
+    fold::triangle_constant_buffer triangle{};
+    std::uint32_t                  output_width{};
+    std::uint32_t                  output_height{};
+    staging::patch                 crop{};
+    sample::window                 screenshot{};
+    bool                           is_stale{true};
+};
+} // namespace engine
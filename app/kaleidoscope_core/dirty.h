@@ -0,0 +1,203 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "fold.h"
+#include "image.h"
+#include "source.h"
+#include "span.h"
+
+namespace dirty
+{
+
+// Turns the dirty rects of a source frame into the output areas that have
+// to be rendered again.
+//
+// The output is cut into tiles, and each tile remembers the bounding box of
+// the source texels it reads, found by walking the segments of "span.h". A
+// frame then only marks the tiles whose box meets a dirty rect. Changes that
+// miss the triangle mark nothing, and a small change inside it marks about
+// as many tiles as the pattern has copies of the changed pixels.
+class tracker
+{
+public:
+    auto static constexpr tile_width  = 64u; // a multiple of a cache line of pixels
+    auto static constexpr tile_height = 32u;
+
+public:
+    auto on_resize(std::uint32_t width, std::uint32_t height) -> void
+    {
+        output_width  = width;
+        output_height = height;
+        is_stale      = true;
+    }
+
+    auto on_update(fold::aligned_regular_triangle const & triangle) -> void
+    {
+        current  = triangle;
+        is_stale = true;
+    }
+
+    // Collect the areas for this frame. Everything is dirty after a resize,
+    // an update or a change of the source size.
+    auto on_capture(capture::frame_info const & info) -> void
+    {
+        if (info.width != source_width || info.height != source_height)
+        {
+            source_width  = info.width;
+            source_height = info.height;
+            is_stale      = true;
+        }
+
+        if (is_stale)
+        {
+            rebuild();
+            std::fill(marks.begin(), marks.end(), true);
+            is_stale = false;
+        }
+        else
+        {
+            std::fill(marks.begin(), marks.end(), false);
+            for (auto const & r : info.dirty)
+            {
+                if (!meets(r, reach))
+                    continue;
+
+                for (auto index = std::size_t{}; index < footprints.size(); ++index)
+                    if (!marks[index] && meets(r, footprints[index]))
+                        marks[index] = true;
+            }
+        }
+
+        collect();
+    }
+
+    // Output areas to render, as runs of marked tiles, one or more per row
+    // of tiles. Runs of different tasks never share a cache line.
+    auto areas() const -> std::vector<image::rect> const &
+    {
+        return runs;
+    }
+
+    // Output pixels covered by "areas".
+    auto pixels() const -> std::uint64_t
+    {
+        auto sum = std::uint64_t{};
+        for (auto const & r : runs)
+            sum += std::uint64_t{r.width()} * r.height();
+        return sum;
+    }
+
+private:
+    auto static meets(image::rect const & a, image::rect const & b) -> bool
+    {
+        return !image::intersect(a, b).empty();
+    }
+
+    auto rebuild() -> void
+    {
+        columns = (output_width + tile_width - 1) / tile_width;
+        rows    = (output_height + tile_height - 1) / tile_height;
+        footprints.assign(std::size_t{columns} * rows, image::rect{~0u, ~0u, 0u, 0u});
+        marks.assign(footprints.size(), false);
+        reach = {};
+        if (footprints.empty() || source_width == 0 || source_height == 0)
+            return;
+
+        auto const shape   = span::geometry(current);
+        auto const scale_x = static_cast<double>(source_width) / output_width;
+        auto const scale_y = static_cast<double>(source_height) / output_height;
+        auto       plan    = std::vector<span::segment>{};
+
+        // Texels read by bilinear taps around a source point, with a texel to
+        // spare for rounding.
+        auto const texel = [](double v, std::uint32_t size, int spare) -> std::uint32_t
+        { return static_cast<std::uint32_t>(std::clamp(std::floor(v) + spare, 0., static_cast<double>(size))); };
+
+        for (auto y = 0u; y < output_height; ++y)
+        {
+            plan.clear();
+            shape.plan(y, 0, output_width, plan);
+
+            auto const row = footprints.data() + std::size_t{y / tile_height} * columns;
+            for (auto const & piece : plan)
+            {
+                auto const [ux, uy] = span::step(piece.heading);
+                for (auto begin = piece.begin; begin < piece.end;)
+                {
+                    auto const end = std::min(piece.end, (begin / tile_width + 1) * tile_width);
+
+                    // Both ends of the run, in source texels
+                    auto const a  = static_cast<double>(begin - piece.begin);
+                    auto const b  = static_cast<double>(end - 1 - piece.begin);
+                    auto const x0 = (piece.x + ux * a) * scale_x - .5;
+                    auto const x1 = (piece.x + ux * b) * scale_x - .5;
+                    auto const y0 = (piece.y + uy * a) * scale_y - .5;
+                    auto const y1 = (piece.y + uy * b) * scale_y - .5;
+
+                    auto & box  = row[begin / tile_width];
+                    box.left    = std::min(box.left, texel(std::min(x0, x1), source_width, -1));
+                    box.top     = std::min(box.top, texel(std::min(y0, y1), source_height, -1));
+                    box.right   = std::max(box.right, texel(std::max(x0, x1), source_width, 3));
+                    box.bottom  = std::max(box.bottom, texel(std::max(y0, y1), source_height, 3));
+                    begin       = end;
+                }
+            }
+        }
+
+        reach = footprints.front();
+        for (auto const & box : footprints)
+        {
+            reach.left   = std::min(reach.left, box.left);
+            reach.top    = std::min(reach.top, box.top);
+            reach.right  = std::max(reach.right, box.right);
+            reach.bottom = std::max(reach.bottom, box.bottom);
+        }
+    }
+
+    auto collect() -> void
+    {
+        runs.clear();
+        for (auto ty = 0u; ty < rows; ++ty)
+        {
+            auto const marked = marks.begin() + std::size_t{ty} * columns;
+            auto const top    = ty * tile_height;
+            auto const bottom = std::min(top + tile_height, output_height);
+            for (auto tx = 0u; tx < columns;)
+            {
+                if (!marked[tx])
+                {
+                    ++tx;
+                    continue;
+                }
+
+                auto const first = tx;
+                while (tx < columns && marked[tx])
+                    ++tx;
+                runs.push_back({first * tile_width, top, std::min(tx * tile_width, output_width), bottom});
+            }
+        }
+    }
+
+private:
+    // Inputs
+    fold::aligned_regular_triangle current{};
+    std::uint32_t                  output_width{};
+    std::uint32_t                  output_height{};
+    std::uint32_t                  source_width{};
+    std::uint32_t                  source_height{};
+    bool                           is_stale{true};
+
+    // Per tile, row by row
+    std::uint32_t            columns{};
+    std::uint32_t            rows{};
+    std::vector<image::rect> footprints{};
+    std::vector<bool>        marks{};
+    image::rect              reach{};
+
+    // Output
+    std::vector<image::rect> runs{};
+};
+} // namespace dirty
@@ -0,0 +1,201 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+// A line-by-line port of "pixel_shader.hlsl". Every function here works on
+// normalized texture coordinates in single precision, in the same order of
+// operations as the shader, so that a CPU frame matches the GPU one.
+
+namespace fold
+{
+
+struct float2
+{
+    float x;
+    float y;
+};
+
+auto inline constexpr operator+(float2 a, float2 b) -> float2
+{
+    return {a.x + b.x, a.y + b.y};
+}
+
+auto inline constexpr operator-(float2 a, float2 b) -> float2
+{
+    return {a.x - b.x, a.y - b.y};
+}
+
+auto inline constexpr operator*(float2 a, float2 b) -> float2
+{
+    return {a.x * b.x, a.y * b.y};
+}
+
+auto inline constexpr operator*(float k, float2 a) -> float2
+{
+    return {k * a.x, k * a.y};
+}
+
+auto inline constexpr operator/(float2 a, float2 b) -> float2
+{
+    return {a.x / b.x, a.y / b.y};
+}
+
+auto inline constexpr operator/(float2 a, float k) -> float2
+{
+    return {a.x / k, a.y / k};
+}
+
+// HLSL "frac"
+auto inline frac(float2 a) -> float2
+{
+    return {a.x - std::floor(a.x), a.y - std::floor(a.y)};
+}
+
+// Same as the head of "triangle_group" in the pixel shader and of
+// "triangle_constant_buffer" in render.cc: the top point and sizes,
+// normalized by the output size. The patch mapping that follows there is
+// "sample::window" here.
+struct triangle_constant_buffer
+{
+    float top_x;
+    float top_y;
+    float length;
+    float height;
+};
+
+// Same as "mirror::aligned_regular_triangle": the top point and side length
+// in output pixels.
+struct aligned_regular_triangle
+{
+    float top_x;
+    float top_y;
+    float length;
+};
+
+auto inline constexpr half_sqrt3 = 0.86602540378443864676372317075294f;
+
+// Same as "mirror::core::on_update".
+auto inline normalize(aligned_regular_triangle const & source, std::uint32_t width, std::uint32_t height)
+    -> triangle_constant_buffer
+{
+    auto w        = static_cast<float>(width);
+    auto h        = static_cast<float>(height);
+    auto target   = triangle_constant_buffer{};
+    target.top_x  = source.top_x / w;
+    target.top_y  = source.top_y / h;
+    target.length = source.length / w;
+    target.height = source.length * half_sqrt3 / h;
+    return target;
+}
+
+// TEXCOORD of the center of output pixel (x, y), as interpolated from the
+// full screen quad in render.cc.
+auto inline texcoord(std::uint32_t x, std::uint32_t y, std::uint32_t width, std::uint32_t height) -> float2
+{
+    return {(static_cast<float>(x) + .5f) / static_cast<float>(width),
+            (static_cast<float>(y) + .5f) / static_cast<float>(height)};
+}
+
+auto inline constexpr cross2(float2 a, float2 b) -> float
+{
+    return a.x * b.y - a.y * b.x;
+}
+
+auto inline reflect(float2 source, float2 anchor, float2 mirror, float2 project) -> float2
+{
+    // (? - source) x project = 0
+    // (? + source - 2 * anchor) x mirror = 0
+    // return ?
+
+    auto a = cross2(source, project);
+    auto b = cross2(2.f * anchor - source, mirror);
+    auto k = cross2(mirror, project);
+    return (a * mirror - b * project) / k;
+}
+
+auto inline redirect(triangle_constant_buffer const & t, float2 o) -> float2
+{
+    // Bounding box of the repeat pattern
+    auto const size     = float2{t.length * 3.f, t.height * 2.f};
+    auto const center   = float2{t.top_x + t.length, t.top_y};
+    auto const top_left = float2{t.top_x - t.length * .5f, t.top_y - t.height};
+
+    // Calculate (x, y) in bounding box
+    o = top_left + frac((o - top_left) / size) * size;
+
+    // Reduce range again
+    if (o.x >= center.x && o.y < center.y)
+    {
+        o.x -= size.x * .5f;
+        o.y += size.y * .5f;
+    }
+    else if (o.x >= center.x && o.y >= center.y)
+    {
+        o.x -= size.x * .5f;
+        o.y -= size.y * .5f;
+        o.y = center.y * 2.f - o.y;
+    }
+    else if (o.x < center.x && o.y < center.y)
+    {
+        o.y = center.y * 2.f - o.y;
+    }
+    return o;
+}
+
+// Corners and edges of the triangle, named as in the shader's "main".
+struct corners
+{
+    float2 left_to_top;
+    float2 right_to_top;
+    float2 top;
+    float2 left;
+    float2 right;
+
+    explicit corners(triangle_constant_buffer const & t)
+    {
+        auto const half_length = t.length * .5f;
+
+        left_to_top  = float2{half_length, -t.height};
+        right_to_top = float2{-half_length, -t.height};
+
+        top   = float2{t.top_x, t.top_y};
+        left  = top - left_to_top;
+        right = top - right_to_top;
+    }
+};
+
+// "Ignore if o is inside triangle"
+auto inline is_inside(corners const & c, float2 o) -> bool
+{
+    return cross2(c.top - c.left, o - c.left) >= 0 && //
+           cross2(c.right - c.top, o - c.top) >= 0 && //
+           cross2(c.left - c.right, o - c.right) >= 0;
+}
+
+// Steps [1] to [3] of the shader: where to sample for texture coordinate o.
+// The inside test is not applied, callers decide what to do with it.
+auto inline locate(triangle_constant_buffer const & t, corners const & c, float2 o) -> float2
+{
+    // [1] Minimum repeat pattern
+    o = redirect(t, o);
+
+    // [2] Triangulation
+    if (cross2(c.left_to_top, o - c.right) > 0)
+    {
+        o.x -= t.length * 1.5f;
+        o.y = 2.f * c.top.y + t.height - o.y;
+    }
+
+    // [3] Reflect
+    if (cross2(c.left_to_top, o - c.left) < 0)
+    {
+        o = reflect(o, c.left, c.left_to_top, .5f * c.left_to_top - c.right_to_top);
+    }
+    else if (cross2(c.right_to_top, o - c.right) > 0)
+    {
+        o = reflect(o, c.right, c.right_to_top, .5f * c.right_to_top - c.left_to_top);
+    }
+
+    return o;
+}
+} // namespace fold
@@ -0,0 +1,1019 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "cpu.h"
+#include "fold.h"
+#include "image.h"
+#include "patch.h"
+#include "sample.h"
+#include "simd.h"
+#include "tile_cache.h"
+
+namespace engine
+{
+
+// Precomputed per-pixel fold.
+//
+// For a fixed triangle and output size, every output pixel always samples
+// the same source position. This engine resolves all of them once into a
+// table, after which a frame is a pure gather from the source image.
+//
+// Usage mirrors "mirror":
+//
+// - on_resize / on_update: mark the table stale (cheap, may be called often)
+// - on_capture:            once per frame, rebuilds the table if needed
+// - on_render:             gather, may run concurrently on disjoint areas
+//
+// The source passed to "on_capture" must stay alive until rendering is done,
+// unless "staging::mode::crop" copies the triangle's bounding box out of it.
+// Then the table indexes that patch, whose margin holds every tap, so all
+// pixels take the fast path.
+//
+// With "sample::filter::point" each entry holds the nearest texel only, and
+// a pixel is one 32-bit load and store: "gather_point_area".
+//
+// With "staging::mode::blocks" or "staging::mode::morton" the patch is kept
+// in blocks of 8 x 8 texels, see "staging::patch", and the entries index
+// those. The gather stays the same, only the tap below is a block's stride
+// away, so the diagonal reads of the reflected copies touch far fewer cache
+// lines.
+//
+// Moving the triangle by d moves its fold along: map(p; o + d) is
+// map(p - d; o) + d. With "staging::mode::crop" the entries index the patch,
+// which moves along as well, so after a move by whole texels, a drag, the
+// table is shifted by d and only the pixels shifted in are resolved. Only a
+// new length or size resolves every pixel again.
+//
+// For the same reason the table at any position is a part of one canonical
+// tile per length: one horizontal period of entries, for every row relative
+// to the top. Given a "tiles::cache", a crop mode table at a new length
+// comes from that tile, so a length seen before, in this run or an earlier
+// one, costs a copy instead of resolving every pixel: "assemble". "prepare"
+// makes the tile of a length before the triangle gets there.
+//
+// Both hold for the fold, not for its float math on normalized
+// coordinates: resolved at another position, some taps round to the
+// neighbouring 1/256 of a texel. A shifted or assembled table differs from
+// one resolved in place by up to 2 per channel, and with point sampling a
+// pixel on a tie may show the neighbouring texel.
+//
+// Kaleidoscopes can be stacked: "on_update" with several triangles folds
+// the output of the first again with the second, and so on. As every fold
+// is a mapping of texture coordinates, and one that leaves the inside of
+// its triangle in place, the stages compose into the same table: a pixel
+// goes through the folds from the last stage to the first and samples the
+// source once. Any number of stages costs one gather and no intermediate
+// frames, only building the table takes longer. Where a pass per stage would
+// resample each intermediate frame, the stack samples the source only once,
+// so it is as sharp as a single fold. The last triangle is the transparent
+// one, and since every position ends up inside the first, the crop modes
+// copy the first one's patch. Stacks are always resolved in full, a move
+// doesn't shift them and they have no tiles.
+//
+// "on_cut(false)" keeps the source inside the last triangle, as a recording
+// of the screen shows it, instead of leaving it transparent for the screen
+// to show through.
+class fold_map
+{
+public:
+    // Bits of "entry::taps", set if a bilinear tap lies inside the source.
+    enum tap : std::uint8_t
+    {
+        top_left     = 1 << 0,
+        top_right    = 1 << 1,
+        bottom_left  = 1 << 2,
+        bottom_right = 1 << 3,
+        all          = top_left | top_right | bottom_left | bottom_right,
+    };
+
+    // 8 bytes per output pixel. "taps == 0" means transparent. With point
+    // sampling "taps" is "all" or 0 and the weights are 0.
+    struct entry
+    {
+        std::uint32_t offset; // of the top left tap, in source pixels
+        std::uint8_t  fx;
+        std::uint8_t  fy;
+        std::uint8_t  taps;
+        std::uint8_t  shift; // 1: offset was moved right by one tap, 2: down by one
+    };
+
+    static_assert(sizeof(entry) == 8);
+
+public:
+    // Layout of the canonical tiles, part of their "tiles::key".
+    auto static constexpr tile_version = std::uint32_t{1};
+
+public:
+    explicit fold_map(
+        staging::mode how = staging::mode::full, sample::filter filter = sample::filter::linear,
+        std::shared_ptr<tiles::cache> cache = nullptr
+    )
+        : how(how)
+        , filter(filter)
+        , cache(std::move(cache))
+        , crop(how)
+    {}
+
+    auto on_resize(std::uint32_t width, std::uint32_t height) -> void
+    {
+        if (width == output_width && height == output_height)
+            return;
+
+        output_width  = width;
+        output_height = height;
+        is_stale      = true;
+    }
+
+    auto on_update(fold::aligned_regular_triangle const & triangle) -> void
+    {
+        on_update(std::span{&triangle, 1});
+    }
+
+    // A stack of kaleidoscopes, the first folding the source, see above.
+    auto on_update(std::span<fold::aligned_regular_triangle const> triangles) -> void
+    {
+        if (triangles.empty())
+            return;
+
+        auto const same = [](fold::aligned_regular_triangle const & a, fold::aligned_regular_triangle const & b)
+        { return a.top_x == b.top_x && a.top_y == b.top_y && a.length == b.length; };
+        auto const later = triangles.subspan(1);
+        if (!std::equal(later.begin(), later.end(), stages.begin(), stages.end(), same))
+        {
+            stages.assign(later.begin(), later.end());
+            is_stale = true;
+        }
+
+        auto const & triangle = triangles.front();
+        if (triangle.top_x == current.top_x && triangle.top_y == current.top_y && triangle.length == current.length)
+            return;
+
+        if (triangle.length != current.length)
+            is_stale = true;
+
+        current = triangle;
+    }
+
+    auto on_cut(bool is_cut) -> void
+    {
+        if (is_cut == is_cutting)
+            return;
+
+        is_cutting = is_cut;
+        is_stale   = true;
+    }
+
+    auto on_capture(image::const_view source) -> void
+    {
+        build(source.width, source.height, source.stride);
+        if (staging::is_cropped(how))
+            crop.on_capture(source);
+
+        screenshot = staging::is_cropped(how) ? crop.view() : source;
+    }
+
+    // All of "on_capture" but reading the frame: the table for a source of
+    // this size. May run ahead of the frames, on another thread, see
+    // "engine::deferred".
+    auto build(std::uint32_t width, std::uint32_t height, std::size_t stride) -> void
+    {
+        if (width != source_width || height != source_height || stride != source_stride)
+        {
+            source_width  = width;
+            source_height = height;
+            source_stride = stride;
+            is_stale      = true;
+        }
+
+        auto const is_moved = current.top_x != built.top_x || current.top_y != built.top_y;
+        if (staging::is_cropped(how) && (is_stale || is_moved) && output_width != 0 && output_height != 0)
+        {
+            auto const scale_x = static_cast<double>(source_width) / output_width;
+            auto const scale_y = static_cast<double>(source_height) / output_height;
+            crop.on_update(current, scale_x, scale_y);
+        }
+
+        if (is_stale)
+            rebuild();
+        else if (is_moved)
+            follow();
+    }
+
+    auto on_render(image::view target, image::rect const & area) const -> void
+    {
+        auto const output = image::rect{0, 0, output_width, output_height};
+        auto const region = image::intersect(area, image::intersect(target.bounds(), output));
+        auto const & variants = filter == sample::filter::point ? gather_point_variants : gather_variants;
+        variants.pick()(table.data(), output_width, screenshot, target, region);
+    }
+
+    auto on_render(image::view target) const -> void
+    {
+        on_render(target, target.bounds());
+    }
+
+    // Byte offsets into the source of every texel a frame reads, in the order
+    // "on_render" reads them, for diagnostics. Transparent pixels read
+    // nothing.
+    template <typename F> auto trace(F && visit) const -> void
+    {
+        auto const stride = screenshot.stride;
+        for (auto i = std::size_t{}; i < table.size(); ++i)
+        {
+            auto const & e = table[i];
+            if (e.taps == 0)
+                continue;
+
+            visit(e.offset * sizeof(image::pixel));
+            if (filter == sample::filter::point)
+                continue;
+
+            visit((e.offset + 1) * sizeof(image::pixel));
+            visit((e.offset + stride) * sizeof(image::pixel));
+            visit((e.offset + stride + 1) * sizeof(image::pixel));
+        }
+    }
+
+    // Make sure "cache" holds the canonical tile for "length" at an output of
+    // "width" x "height", captured at the same size, so that a table at that
+    // length is a copy from then on. Meant for a thread of its own, see
+    // "wheel::prebuilder".
+    auto static prepare(
+        std::shared_ptr<tiles::cache> cache, std::uint32_t width, std::uint32_t height, std::uint32_t length,
+        sample::filter filter = sample::filter::linear
+    ) -> void
+    {
+        if (cache == nullptr || width == 0 || height == 0 || length == 0)
+            return;
+
+        // Only the size of the patch matters, not where the triangle is
+        auto map          = fold_map{staging::mode::crop, filter, std::move(cache)};
+        map.output_width  = width;
+        map.output_height = height;
+        map.source_width  = width;
+        map.source_height = height;
+        map.current       = {static_cast<float>(width / 2), 0.f, static_cast<float>(length)};
+        map.crop.on_update(map.current, 1., 1.);
+        map.tile();
+    }
+
+    // Bytes of the table, for diagnostics.
+    auto footprint() const -> std::size_t
+    {
+        return table.size() * sizeof(entry);
+    }
+
+    // The table after "build", "output_width" entries per row, and in the
+    // crop modes the patch its offsets index, else the source. For engines
+    // that gather the same texels from planes of another format, see
+    // "engine::planar".
+    auto entries() const -> std::span<entry const>
+    {
+        return {table.data(), table.size()};
+    }
+
+    auto staged() const -> staging::patch const &
+    {
+        return crop;
+    }
+
+private:
+    auto rebuild() -> void
+    {
+        table.resize(std::size_t{output_width} * output_height);
+        if (!assemble())
+            resolve(current, {0, 0, output_width, output_height}, table.data(), output_width, is_cutting);
+        built    = current;
+        is_stale = false;
+    }
+
+    // In front of the entries of a canonical tile.
+    struct tile_header
+    {
+        std::uint32_t output_width;
+        std::uint32_t output_height;
+        std::uint32_t patch_width;
+        std::uint32_t patch_height;
+        std::uint32_t patch_stride;
+        std::uint32_t columns; // one horizontal period, 3 x length
+        std::uint32_t rows;    // relative to the top, from "1 - output_height" to "output_height - 1"
+        std::uint32_t reserved[9];
+    };
+
+    static_assert(sizeof(tile_header) == 64);
+
+    // The table from the canonical tile of the cache, made and stored first
+    // if it has none. Entry (x, y) is entry (x - top_x mod columns, y - top_y)
+    // of the tile, then the inside of the triangle is cut out. False if the
+    // table can't come from a tile.
+    auto assemble() -> bool
+    {
+        auto const whole = [](float v) { return std::floor(v) == v; };
+        if (cache == nullptr || how != staging::mode::crop || !stages.empty() || source_width != output_width
+            || source_height != output_height || !whole(current.length) || !whole(current.top_x)
+            || !whole(current.top_y) || current.length < 1.f || current.top_y < 0.f || current.top_y >= output_height)
+            return false;
+
+        auto const payload = tiles::cache::payload(*tile());
+        if (!is_tile(payload))
+            return false;
+
+        auto head = tile_header{};
+        std::memcpy(&head, payload.data(), sizeof(head));
+        auto const entries = reinterpret_cast<entry const *>(payload.data() + sizeof(head));
+        auto const columns = static_cast<std::int64_t>(head.columns);
+        auto const shift   = -static_cast<std::int64_t>(current.top_x);
+        auto const start   = static_cast<std::uint32_t>((shift % columns + columns) % columns);
+        auto const top     = static_cast<std::uint32_t>(current.top_y);
+
+        for (auto y = 0u; y < output_height; ++y)
+        {
+            auto const from = entries + std::size_t{y - top + output_height - 1} * head.columns;
+            auto const into = table.data() + std::size_t{y} * output_width;
+            for (auto x = 0u, c = start; x < output_width; c = 0)
+            {
+                auto const count = std::min(head.columns - c, output_width - x);
+                std::memcpy(into + x, from + c, count * sizeof(entry));
+                x += count;
+            }
+        }
+
+        // The inside of the triangle, from its bounding box
+        if (!is_cutting)
+            return true;
+
+        auto const triangle = fold::normalize(current, output_width, output_height);
+        auto const corners  = fold::corners(triangle);
+        auto const box      = staging::bounds(current, 1., 1.);
+        auto const clip     = [](std::int64_t v, std::uint32_t size)
+        { return static_cast<std::uint32_t>(std::clamp<std::int64_t>(v, 0, size)); };
+        auto const area = image::rect{
+            clip(box.left, output_width),
+            clip(box.top, output_height),
+            clip(std::int64_t{box.left} + box.width, output_width),
+            clip(std::int64_t{box.top} + box.height, output_height),
+        };
+        for (auto y = area.top; y < area.bottom; ++y)
+        {
+            auto const row = table.data() + std::size_t{y} * output_width;
+            for (auto x = area.left; x < area.right; ++x)
+                if (fold::is_inside(corners, fold::texcoord(x, y, output_width, output_height)))
+                    row[x] = entry{};
+        }
+        return true;
+    }
+
+    // The canonical tile for "current" from the cache, made and stored first
+    // if it has none, or waited for if another thread is making it.
+    auto tile() const -> std::shared_ptr<tiles::blob const>
+    {
+        auto const size = static_cast<std::uint32_t>(current.length);
+        auto const k    = tiles::key{output_width, output_height, size, filter, tile_version};
+        return cache->obtain(
+            k, [this](std::span<std::byte const> payload) { return is_tile(payload); },
+            [this] { return canonical(); }
+        );
+    }
+
+    // The canonical tile for "current", see "assemble". Blocks of the output
+    // size are resolved with the triangle placed so that each block lands on
+    // the output. The inside of the triangle isn't cut out, as it doesn't
+    // repeat with the period.
+    auto canonical() const -> std::vector<std::byte>
+    {
+        auto const pixels = crop.view();
+        auto const head   = tile_header{
+            output_width,  output_height, pixels.width, pixels.height, static_cast<std::uint32_t>(pixels.stride),
+            static_cast<std::uint32_t>(current.length) * 3, 2 * output_height - 1, {},
+        };
+
+        auto out = std::vector<std::byte>(sizeof(head) + std::size_t{head.columns} * head.rows * sizeof(entry));
+        std::memcpy(out.data(), &head, sizeof(head));
+        auto const entries = reinterpret_cast<entry *>(out.data() + sizeof(head));
+
+        for (auto row = 0u; row < head.rows; row += output_height)
+        {
+            for (auto column = 0u; column < head.columns; column += output_width)
+            {
+                auto at  = current;
+                at.top_x = -static_cast<float>(column);
+                at.top_y = static_cast<float>(output_height - 1) - static_cast<float>(row);
+
+                auto const width  = std::min(output_width, head.columns - column);
+                auto const height = std::min(output_height, head.rows - row);
+                auto const into   = entries + std::size_t{row} * head.columns + column;
+                resolve(at, {0, 0, width, height}, into, head.columns, false);
+            }
+        }
+        return out;
+    }
+
+    auto is_tile(std::span<std::byte const> payload) const -> bool
+    {
+        auto head = tile_header{};
+        if (payload.size() < sizeof(head))
+            return false;
+
+        std::memcpy(&head, payload.data(), sizeof(head));
+        auto const pixels = crop.view();
+        return head.output_width == output_width && head.output_height == output_height
+            && head.patch_width == pixels.width && head.patch_height == pixels.height
+            && head.patch_stride == pixels.stride && head.columns == static_cast<std::uint32_t>(current.length) * 3
+            && head.rows == 2 * output_height - 1
+            && payload.size() == sizeof(head) + std::size_t{head.columns} * head.rows * sizeof(entry);
+    }
+
+    // Shift the table after a move of the triangle, see above, or rebuild
+    // it if the move isn't by whole texels. The shifted entries keep the
+    // rounding of where they were resolved.
+    auto follow() -> void
+    {
+        auto const scale_x = static_cast<double>(source_width) / output_width;
+        auto const scale_y = static_cast<double>(source_height) / output_height;
+        auto const dx      = static_cast<double>(current.top_x) - built.top_x;
+        auto const dy      = static_cast<double>(current.top_y) - built.top_y;
+        auto const whole   = [](double v) { return std::floor(v) == v; };
+        if (!staging::is_cropped(how) || !stages.empty() || !whole(dx) || !whole(dy) || !whole(dx * scale_x)
+            || !whole(dy * scale_y) || std::abs(dx) >= output_width || std::abs(dy) >= output_height)
+            return rebuild();
+
+        auto const w = static_cast<std::int32_t>(output_width);
+        auto const h = static_cast<std::int32_t>(output_height);
+        auto const x = static_cast<std::int32_t>(dx);
+        auto const y = static_cast<std::int32_t>(dy);
+
+        // Row "r" of the table becomes row "r + y", bottom up if that is down.
+        auto const kept = static_cast<std::size_t>(w - std::abs(x)) * sizeof(entry);
+        for (auto i = 0; i < h - std::abs(y); ++i)
+        {
+            auto const to   = y > 0 ? h - 1 - i : i;
+            auto const from = table.data() + static_cast<std::size_t>(to - y) * output_width;
+            auto const into = table.data() + static_cast<std::size_t>(to) * output_width;
+            std::memmove(into + std::max(x, 0), from + std::max(-x, 0), kept);
+        }
+
+        // The rows, then the columns that were shifted in
+        auto const u  = static_cast<std::uint32_t>(std::abs(x));
+        auto const v  = static_cast<std::uint32_t>(std::abs(y));
+        auto const r0 = y > 0 ? 0u : output_height - v;
+        auto const c0 = x > 0 ? 0u : output_width - u;
+        auto const t0 = y > 0 ? v : 0u;
+        auto const at = [&](std::uint32_t x, std::uint32_t y)
+        { return table.data() + std::size_t{y} * output_width + x; };
+        resolve(current, {0, r0, output_width, r0 + v}, at(0, r0), output_width, is_cutting);
+        resolve(current, {c0, t0, c0 + u, t0 + output_height - v}, at(c0, t0), output_width, is_cutting);
+        built = current;
+    }
+
+    // Entries of output pixels "area" for the triangle "at", into rows of
+    // "pitch" entries from "into", the entry of the area's top left pixel,
+    // followed by "stages". Pixels inside the last triangle are transparent,
+    // unless "is_cut" is false.
+    auto resolve(
+        fold::aligned_regular_triangle const & at, image::rect const & area, entry * into, std::size_t pitch,
+        bool is_cut = true
+    ) const -> void
+    {
+        if (area.empty())
+            return;
+
+        auto const triangle = fold::normalize(at, output_width, output_height);
+        auto const corners  = fold::corners(triangle);
+
+        // The stages after "at", in the order a pixel goes through them
+        struct stage
+        {
+            fold::triangle_constant_buffer triangle;
+            fold::corners                  corners;
+        };
+        auto later = std::vector<stage>{};
+        for (auto s = stages.rbegin(); s != stages.rend(); ++s)
+        {
+            auto const t = fold::normalize(*s, output_width, output_height);
+            later.push_back({t, fold::corners(t)});
+        }
+        auto const & last = later.empty() ? corners : later.front().corners;
+
+        // The texels of the source that the table indexes, of the patch of
+        // "at" in the crop modes
+        auto const is_crop = staging::is_cropped(how);
+        auto const scale_x = static_cast<double>(source_width) / output_width;
+        auto const scale_y = static_cast<double>(source_height) / output_height;
+        auto const origin  = is_crop ? staging::bounds(at, scale_x, scale_y) : staging::region{};
+        auto const whole   = image::const_view{nullptr, source_width, source_height, source_stride};
+        auto const pixels  = is_crop ? crop.view() : whole;
+        auto const left    = origin.left;
+        auto const top     = origin.top;
+        auto const w       = static_cast<std::int32_t>(pixels.width);
+        auto const h       = static_cast<std::int32_t>(pixels.height);
+        auto const stride  = static_cast<std::int32_t>(pixels.stride);
+        auto const address = [&](std::int32_t tx, std::int32_t ty)
+        {
+            return is_crop ? crop.offset(static_cast<std::uint32_t>(tx), static_cast<std::uint32_t>(ty))
+                           : static_cast<std::uint32_t>(ty * stride + tx);
+        };
+
+        for (auto y = area.top; y < area.bottom; ++y)
+        {
+            auto row = into + std::size_t{y - area.top} * pitch;
+            for (auto x = area.left, i = 0u; x < area.right; ++x, ++i)
+            {
+                auto o = fold::texcoord(x, y, output_width, output_height);
+                if (is_cut && fold::is_inside(last, o))
+                {
+                    row[i] = entry{};
+                    continue;
+                }
+
+                for (auto const & s : later)
+                    o = fold::locate(s.triangle, s.corners, o);
+
+                auto t = sample::resolve(fold::locate(triangle, corners, o), source_width, source_height);
+                t.x -= left;
+                t.y -= top;
+
+                if (filter == sample::filter::point)
+                {
+                    auto n  = sample::nearest(t);
+                    auto in = n.x >= 0 && n.x < w && n.y >= 0 && n.y < h;
+                    row[i]  = in ? entry{address(n.x, n.y), 0, 0, tap::all, 0} : entry{};
+                    continue;
+                }
+
+                auto is_x0 = t.x >= 0 && t.x < w;
+                auto is_x1 = t.x + 1 >= 0 && t.x + 1 < w;
+                auto is_y0 = t.y >= 0 && t.y < h;
+                auto is_y1 = t.y + 1 >= 0 && t.y + 1 < h;
+                auto taps  = std::uint8_t{};
+                taps |= is_x0 && is_y0 ? tap::top_left : 0;
+                taps |= is_x1 && is_y0 ? tap::top_right : 0;
+                taps |= is_x0 && is_y1 ? tap::bottom_left : 0;
+                taps |= is_x1 && is_y1 ? tap::bottom_right : 0;
+
+                // Taps left of or above the source are never read, but the
+                // offset is kept non-negative and "shift" records the move.
+                auto cx = std::max(t.x, 0);
+                auto cy = std::max(t.y, 0);
+                row[i]  = entry{
+                    taps ? address(cx, cy) : 0,
+                    t.fx,
+                    t.fy,
+                    taps,
+                    static_cast<std::uint8_t>((t.x < 0 ? 1 : 0) | (t.y < 0 ? 2 : 0)),
+                };
+            }
+        }
+    }
+
+    KALEIDOSCOPE_INLINE auto static gather(image::pixel const * source, std::size_t stride, entry const & e)
+        -> image::pixel
+    {
+        auto const s = source + e.offset;
+        if (e.taps == tap::all)
+            return sample::blend(s[0], s[1], s[stride], s[stride + 1], e.fx, e.fy);
+        return gather_at_border(source, stride, e);
+    }
+
+    // The frame for "region": one table entry per pixel, "width" per row.
+    // This is the scalar reference the vectorized builds below must match.
+    KALEIDOSCOPE_INLINE auto static gather_area(
+        entry const * table, std::uint32_t width, image::const_view screenshot, image::view target,
+        image::rect const & region
+    ) -> void
+    {
+        for (auto y = region.top; y < region.bottom; ++y)
+        {
+            auto line = target.row(y);
+            auto from = table + std::size_t{y} * width;
+            for (auto x = region.left; x < region.right; ++x)
+                line[x] = gather(screenshot.data, screenshot.stride, from[x]);
+        }
+    }
+
+    // The vectorized builds blend blocks whose entries are all on the fast
+    // path or transparent. Transparent entries point at texel (0, 0), so they
+    // are blended like the others and masked off afterwards, as long as the
+    // source has a second row and column to read.
+    auto static is_blockable(image::const_view screenshot) -> bool
+    {
+        return screenshot.width >= 2 && screenshot.height >= 2;
+    }
+
+    auto static is_plain(entry const * e, std::uint32_t count) -> bool
+    {
+        for (auto i = 0u; i < count; ++i)
+            if (e[i].taps != 0 && e[i].taps != tap::all)
+                return false;
+        return true;
+    }
+
+#ifdef KALEIDOSCOPE_SSE2
+    // 8 pixels per iteration, in two "simd::blend4" of 4. Taps are fetched
+    // with scalar loads, since SSE2 has no gather.
+    KALEIDOSCOPE_INLINE auto static gather_area_sse2(
+        entry const * table, std::uint32_t width, image::const_view screenshot, image::view target,
+        image::rect const & region
+    ) -> void
+    {
+        if (!is_blockable(screenshot))
+            return gather_area(table, width, screenshot, target, region);
+
+        auto const source = screenshot.data;
+        auto const stride = screenshot.stride;
+        auto const load   = [](image::pixel const * v) { return _mm_load_si128(reinterpret_cast<__m128i const *>(v)); };
+
+        alignas(16) image::pixel a[4], b[4], c[4], d[4], wx[4], wy[4], keep[4];
+        for (auto y = region.top; y < region.bottom; ++y)
+        {
+            auto line = target.row(y);
+            auto from = table + std::size_t{y} * width;
+            auto x    = region.left;
+            for (; x + 8 <= region.right; x += 8)
+            {
+                if (!is_plain(from + x, 8))
+                {
+                    for (auto i = x; i < x + 8; ++i)
+                        line[i] = gather(source, stride, from[i]);
+                    continue;
+                }
+
+                for (auto half = 0u; half < 8; half += 4)
+                {
+                    for (auto k = 0u; k < 4; ++k)
+                    {
+                        auto const & e = from[x + half + k];
+                        auto const   s = source + e.offset;
+                        a[k]           = s[0];
+                        b[k]           = s[1];
+                        c[k]           = s[stride];
+                        d[k]           = s[stride + 1];
+                        wx[k]          = e.fx;
+                        wy[k]          = e.fy;
+                        keep[k]        = e.taps ? ~image::pixel{} : image::pixel{};
+                    }
+
+                    auto blended = simd::blend4(load(a), load(b), load(c), load(d), load(wx), load(wy));
+                    blended      = _mm_and_si128(blended, load(keep));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(line + x + half), blended);
+                }
+            }
+            for (; x < region.right; ++x)
+                line[x] = gather(source, stride, from[x]);
+        }
+    }
+#endif
+
+#ifdef KALEIDOSCOPE_X86
+    // 8 pixels per iteration. Each gather fetches both taps of a row as one
+    // 64-bit word, which is then split into the left and the right taps.
+    KALEIDOSCOPE_TARGET_AVX2 auto static gather_area_avx2(
+        entry const * table, std::uint32_t width, image::const_view screenshot, image::view target,
+        image::rect const & region
+    ) -> void
+    {
+        if (!is_blockable(screenshot))
+            return gather_area(table, width, screenshot, target, region);
+
+        auto const source = screenshot.data;
+        auto const stride = screenshot.stride;
+        auto const top    = reinterpret_cast<long long const *>(source);
+        auto const bottom = reinterpret_cast<long long const *>(source + stride);
+        auto const order  = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        auto const zero   = _mm256_setzero_si256();
+        auto const all    = _mm256_set1_epi32(tap::all);
+        auto const byte   = _mm256_set1_epi32(0xff);
+
+        for (auto y = region.top; y < region.bottom; ++y)
+        {
+            auto line = target.row(y);
+            auto from = table + std::size_t{y} * width;
+            auto x    = region.left;
+            for (; x + 8 <= region.right; x += 8)
+            {
+                // [offset, weights and taps] x 8 -> offsets of 0-3 | metadata of 0-3, then of 4-7
+                auto const e0   = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(from + x));
+                auto const e1   = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(from + x + 4));
+                auto const p0   = _mm256_permutevar8x32_epi32(e0, order);
+                auto const p1   = _mm256_permutevar8x32_epi32(e1, order);
+                auto const meta = _mm256_permute2x128_si256(p0, p1, 0x31);
+                auto const taps = _mm256_and_si256(_mm256_srli_epi32(meta, 16), byte);
+                auto const none = _mm256_cmpeq_epi32(taps, zero);
+                auto const full = _mm256_cmpeq_epi32(taps, all);
+                if (_mm256_movemask_epi8(_mm256_or_si256(none, full)) != -1)
+                {
+                    for (auto i = x; i < x + 8; ++i)
+                        line[i] = gather(source, stride, from[i]);
+                    continue;
+                }
+
+                auto const o0 = _mm256_castsi256_si128(p0);
+                auto const o1 = _mm256_castsi256_si128(p1);
+                auto const t0 = _mm256_permutevar8x32_epi32(_mm256_i32gather_epi64(top, o0, 4), order);
+                auto const t1 = _mm256_permutevar8x32_epi32(_mm256_i32gather_epi64(top, o1, 4), order);
+                auto const b0 = _mm256_permutevar8x32_epi32(_mm256_i32gather_epi64(bottom, o0, 4), order);
+                auto const b1 = _mm256_permutevar8x32_epi32(_mm256_i32gather_epi64(bottom, o1, 4), order);
+
+                auto const blended = simd::blend8(
+                    _mm256_permute2x128_si256(t0, t1, 0x20), _mm256_permute2x128_si256(t0, t1, 0x31),
+                    _mm256_permute2x128_si256(b0, b1, 0x20), _mm256_permute2x128_si256(b0, b1, 0x31),
+                    _mm256_and_si256(meta, byte), _mm256_and_si256(_mm256_srli_epi32(meta, 8), byte)
+                );
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(line + x), _mm256_andnot_si256(none, blended));
+            }
+            for (; x < region.right; ++x)
+                line[x] = gather(source, stride, from[x]);
+        }
+    }
+
+    // 16 pixels per iteration, same as "gather_area_avx2".
+    KALEIDOSCOPE_TARGET_AVX512 auto static gather_area_avx512(
+        entry const * table, std::uint32_t width, image::const_view screenshot, image::view target,
+        image::rect const & region
+    ) -> void
+    {
+        if (!is_blockable(screenshot))
+            return gather_area(table, width, screenshot, target, region);
+
+        auto const source = screenshot.data;
+        auto const stride = screenshot.stride;
+        auto const top    = static_cast<void const *>(source);
+        auto const bottom = static_cast<void const *>(source + stride);
+        auto const evens  = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+        auto const odds   = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+        auto const zero   = _mm512_setzero_si512();
+        auto const all    = _mm512_set1_epi32(tap::all);
+        auto const byte   = _mm512_set1_epi32(0xff);
+
+        for (auto y = region.top; y < region.bottom; ++y)
+        {
+            auto line = target.row(y);
+            auto from = table + std::size_t{y} * width;
+            auto x    = region.left;
+            for (; x + 16 <= region.right; x += 16)
+            {
+                auto const e0     = _mm512_loadu_si512(from + x);
+                auto const e1     = _mm512_loadu_si512(from + x + 8);
+                auto const offset = _mm512_permutex2var_epi32(e0, evens, e1);
+                auto const meta   = _mm512_permutex2var_epi32(e0, odds, e1);
+                auto const taps   = _mm512_and_si512(_mm512_srli_epi32(meta, 16), byte);
+                auto const none   = _mm512_cmpeq_epi32_mask(taps, zero);
+                auto const full   = _mm512_cmpeq_epi32_mask(taps, all);
+                if ((none | full) != 0xffff)
+                {
+                    for (auto i = x; i < x + 16; ++i)
+                        line[i] = gather(source, stride, from[i]);
+                    continue;
+                }
+
+                auto const o0 = _mm512_castsi512_si256(offset);
+                auto const o1 = _mm512_extracti64x4_epi64(offset, 1);
+                auto const t0 = _mm512_i32gather_epi64(o0, top, 4);
+                auto const t1 = _mm512_i32gather_epi64(o1, top, 4);
+                auto const b0 = _mm512_i32gather_epi64(o0, bottom, 4);
+                auto const b1 = _mm512_i32gather_epi64(o1, bottom, 4);
+
+                auto const blended = simd::blend16(
+                    _mm512_permutex2var_epi32(t0, evens, t1), _mm512_permutex2var_epi32(t0, odds, t1),
+                    _mm512_permutex2var_epi32(b0, evens, b1), _mm512_permutex2var_epi32(b0, odds, b1),
+                    _mm512_and_si512(meta, byte), _mm512_and_si512(_mm512_srli_epi32(meta, 8), byte)
+                );
+                _mm512_storeu_si512(line + x, _mm512_maskz_mov_epi32(static_cast<__mmask16>(~none), blended));
+            }
+            for (; x < region.right; ++x)
+                line[x] = gather(source, stride, from[x]);
+        }
+    }
+#endif
+
+    // "gather_area" built for each level of "cpu.h".
+    using gather_fn = void (*)(entry const *, std::uint32_t, image::const_view, image::view, image::rect const &);
+
+    auto static gather_baseline(
+        entry const * table, std::uint32_t width, image::const_view screenshot, image::view target,
+        image::rect const & region
+    ) -> void
+    {
+#ifdef KALEIDOSCOPE_SSE2
+        gather_area_sse2(table, width, screenshot, target, region);
+#else
+        gather_area(table, width, screenshot, target, region);
+#endif
+    }
+
+    KALEIDOSCOPE_TARGET_SSE42 auto static gather_sse42(
+        entry const * table, std::uint32_t width, image::const_view screenshot, image::view target,
+        image::rect const & region
+    ) -> void
+    {
+#ifdef KALEIDOSCOPE_SSE2
+        gather_area_sse2(table, width, screenshot, target, region);
+#else
+        gather_area(table, width, screenshot, target, region);
+#endif
+    }
+
+    KALEIDOSCOPE_TARGET_AVX2 auto static gather_avx2(
+        entry const * table, std::uint32_t width, image::const_view screenshot, image::view target,
+        image::rect const & region
+    ) -> void
+    {
+#ifdef KALEIDOSCOPE_X86
+        gather_area_avx2(table, width, screenshot, target, region);
+#else
+        gather_area(table, width, screenshot, target, region);
+#endif
+    }
+
+    KALEIDOSCOPE_TARGET_AVX512 auto static gather_avx512(
+        entry const * table, std::uint32_t width, image::const_view screenshot, image::view target,
+        image::rect const & region
+    ) -> void
+    {
+#ifdef KALEIDOSCOPE_X86
+        gather_area_avx512(table, width, screenshot, target, region);
+#else
+        gather_area(table, width, screenshot, target, region);
+#endif
+    }
+
+    auto static constexpr gather_variants =
+        cpu::variants<gather_fn>{gather_baseline, gather_sse42, gather_avx2, gather_avx512};
+
+    // The frame for "region" with point sampling: one texel per pixel.
+    KALEIDOSCOPE_INLINE auto static gather_point_area(
+        entry const * table, std::uint32_t width, image::const_view screenshot, image::view target,
+        image::rect const & region
+    ) -> void
+    {
+        auto const source = screenshot.data;
+        for (auto y = region.top; y < region.bottom; ++y)
+        {
+            auto line = target.row(y);
+            auto from = table + std::size_t{y} * width;
+            for (auto x = region.left; x < region.right; ++x)
+                line[x] = from[x].taps ? source[from[x].offset] : 0;
+        }
+    }
+
+#ifdef KALEIDOSCOPE_X86
+    // 8 pixels per iteration: one masked 32-bit gather, transparent pixels
+    // load nothing.
+    KALEIDOSCOPE_TARGET_AVX2 auto static gather_point_area_avx2(
+        entry const * table, std::uint32_t width, image::const_view screenshot, image::view target,
+        image::rect const & region
+    ) -> void
+    {
+        auto const source = reinterpret_cast<int const *>(screenshot.data);
+        auto const order  = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        auto const zero   = _mm256_setzero_si256();
+        auto const taps   = _mm256_set1_epi32(0xff << 16);
+
+        for (auto y = region.top; y < region.bottom; ++y)
+        {
+            auto line = target.row(y);
+            auto from = table + std::size_t{y} * width;
+            auto x    = region.left;
+            for (; x + 8 <= region.right; x += 8)
+            {
+                auto const e0     = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(from + x));
+                auto const e1     = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(from + x + 4));
+                auto const p0     = _mm256_permutevar8x32_epi32(e0, order);
+                auto const p1     = _mm256_permutevar8x32_epi32(e1, order);
+                auto const offset = _mm256_permute2x128_si256(p0, p1, 0x20);
+                auto const meta   = _mm256_permute2x128_si256(p0, p1, 0x31);
+                auto const none   = _mm256_cmpeq_epi32(_mm256_and_si256(meta, taps), zero);
+                auto const keep   = _mm256_xor_si256(none, _mm256_set1_epi32(-1));
+                auto const pixels = _mm256_mask_i32gather_epi32(zero, source, offset, keep, 4);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(line + x), pixels);
+            }
+            for (; x < region.right; ++x)
+                line[x] = from[x].taps ? screenshot.data[from[x].offset] : 0;
+        }
+    }
+
+    // 16 pixels per iteration, same as "gather_point_area_avx2".
+    KALEIDOSCOPE_TARGET_AVX512 auto static gather_point_area_avx512(
+        entry const * table, std::uint32_t width, image::const_view screenshot, image::view target,
+        image::rect const & region
+    ) -> void
+    {
+        auto const source = static_cast<void const *>(screenshot.data);
+        auto const evens  = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+        auto const odds   = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+        auto const taps   = _mm512_set1_epi32(0xff << 16);
+
+        for (auto y = region.top; y < region.bottom; ++y)
+        {
+            auto line = target.row(y);
+            auto from = table + std::size_t{y} * width;
+            auto x    = region.left;
+            for (; x + 16 <= region.right; x += 16)
+            {
+                auto const e0     = _mm512_loadu_si512(from + x);
+                auto const e1     = _mm512_loadu_si512(from + x + 8);
+                auto const offset = _mm512_permutex2var_epi32(e0, evens, e1);
+                auto const meta   = _mm512_permutex2var_epi32(e0, odds, e1);
+                auto const keep   = _mm512_test_epi32_mask(meta, taps);
+                auto const pixels = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), keep, offset, source, 4);
+                _mm512_storeu_si512(line + x, pixels);
+            }
+            for (; x < region.right; ++x)
+                line[x] = from[x].taps ? screenshot.data[from[x].offset] : 0;
+        }
+    }
+#endif
+
+    // "gather_point_area" built for each level of "cpu.h". SSE2 has no
+    // gather, so below AVX2 the scalar loop is the fastest.
+    auto static gather_point_baseline(
+        entry const * table, std::uint32_t width, image::const_view screenshot, image::view target,
+        image::rect const & region
+    ) -> void
+    {
+        gather_point_area(table, width, screenshot, target, region);
+    }
+
+    KALEIDOSCOPE_TARGET_SSE42 auto static gather_point_sse42(
+        entry const * table, std::uint32_t width, image::const_view screenshot, image::view target,
+        image::rect const & region
+    ) -> void
+    {
+        gather_point_area(table, width, screenshot, target, region);
+    }
+
+    KALEIDOSCOPE_TARGET_AVX2 auto static gather_point_avx2(
+        entry const * table, std::uint32_t width, image::const_view screenshot, image::view target,
+        image::rect const & region
+    ) -> void
+    {
+#ifdef KALEIDOSCOPE_X86
+        gather_point_area_avx2(table, width, screenshot, target, region);
+#else
+        gather_point_area(table, width, screenshot, target, region);
+#endif
+    }
+
+    KALEIDOSCOPE_TARGET_AVX512 auto static gather_point_avx512(
+        entry const * table, std::uint32_t width, image::const_view screenshot, image::view target,
+        image::rect const & region
+    ) -> void
+    {
+#ifdef KALEIDOSCOPE_X86
+        gather_point_area_avx512(table, width, screenshot, target, region);
+#else
+        gather_point_area(table, width, screenshot, target, region);
+#endif
+    }
+
+    auto static constexpr gather_point_variants =
+        cpu::variants<gather_fn>{gather_point_baseline, gather_point_sse42, gather_point_avx2, gather_point_avx512};
+
+    // Slow path for pixels whose taps straddle the edge of the source.
+    auto static gather_at_border(image::pixel const * source, std::size_t stride, entry const & e) -> image::pixel
+    {
+        if (e.taps == 0)
+            return 0;
+
+        auto const st   = static_cast<std::ptrdiff_t>(stride);
+        auto const dx   = (e.shift & 1) ? std::ptrdiff_t{1} : std::ptrdiff_t{0};
+        auto const dy   = (e.shift & 2) ? st : std::ptrdiff_t{0};
+        auto const base = static_cast<std::ptrdiff_t>(e.offset) - dx - dy;
+        auto const at   = [&](std::uint8_t bit, std::ptrdiff_t offset)
+        { return (e.taps & bit) ? source[base + offset] : image::pixel{}; };
+
+        return sample::blend(
+            at(tap::top_left, 0), at(tap::top_right, 1), at(tap::bottom_left, st), at(tap::bottom_right, st + 1), e.fx,
+            e.fy
+        );
+    }
+
+private:
+    // Inputs
+    fold::aligned_regular_triangle current{};
+    std::vector<fold::aligned_regular_triangle> stages{}; // folded after "current", in order
+    std::uint32_t                  output_width{};
+    std::uint32_t                  output_height{};
+    std::uint32_t                  source_width{};
+    std::uint32_t                  source_height{};
+    std::size_t                    source_stride{};
+
+    // Table and the frame it gathers from
+    staging::mode        how;
+    sample::filter       filter;
+    std::shared_ptr<tiles::cache> cache;
+    staging::patch       crop{};
+    image::buffer<entry> table{};
+    image::const_view    screenshot{};
+    fold::aligned_regular_triangle built{}; // the triangle of "table"
+    bool                 is_cutting{true};
+    bool                 is_stale{true};
+};
+} // namespace engine
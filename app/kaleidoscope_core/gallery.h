@@ -0,0 +1,203 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "fold.h"
+#include "image.h"
+#include "parallel.h"
+#include "patch.h"
+#include "sample.h"
+#include "scanline.h"
+
+namespace engine
+{
+
+// Thumbnails of one captured frame, one per triangle, e.g. for previews.
+//
+// One engine going through the triangles, "on_update" and "on_render" for
+// each, would plan its runs anew for every thumbnail of every frame, and
+// stage every triangle at the size of the screen. Here the frame is staged
+// once per thumbnail size instead: sampled at the center of every pixel of
+// a thumbnail, as the fold samples it, into a frame shared by all
+// thumbnails of that size. Each thumbnail keeps a "scanline" of its own on
+// that frame, so its runs are planned once per triangle, and read their
+// rows contiguously as they do at full size. The price is a second
+// bilinear resampling wherever a copy doesn't land on texel centers.
+//
+// Staging and rendering are one run of the pool each, in bands of rows of
+// all frames, so that even a few small thumbnails keep all threads busy.
+//
+// Each triangle is in pixels of its own thumbnail, as "on_update" of the
+// other engines takes it for their output. Thumbnails may differ in size.
+class gallery
+{
+public:
+    struct item
+    {
+        fold::aligned_regular_triangle triangle;
+        image::view                    target;
+    };
+
+public:
+    explicit gallery(sample::filter filter = sample::filter::linear, staging::mode how = staging::mode::crop)
+        : filter(filter)
+        , how(how)
+    {}
+
+    // The targets must stay alive until rendering is done. A thumbnail keeps
+    // its runs as long as its size and side length stay the same.
+    auto on_update(std::span<item const> thumbnails) -> void
+    {
+        items.assign(thumbnails.begin(), thumbnails.end());
+        slots.resize(std::min(slots.size(), items.size()));
+        while (slots.size() < items.size())
+            slots.push_back({scanline{filter, how}});
+
+        // A shared frame per size, kept as long as the size is in use
+        auto used = std::vector<bool>(scaled.size());
+        for (auto i = std::size_t{}; i < items.size(); ++i)
+        {
+            auto const & [triangle, target] = items[i];
+            auto &       slot               = slots[i];
+            auto const   is_size            = [&](image::frame const & f)
+            { return f.width() == target.width && f.height() == target.height; };
+
+            auto const found = std::find_if(scaled.begin(), scaled.end(), is_size);
+            slot.frame       = static_cast<std::size_t>(found - scaled.begin());
+            if (slot.frame == scaled.size())
+            {
+                scaled.emplace_back(target.width, target.height);
+                used.push_back(false);
+            }
+            used[slot.frame] = true;
+
+            if (slot.width != target.width || slot.height != target.height)
+            {
+                slot.engine.on_resize(target.width, target.height);
+                slot.width  = target.width;
+                slot.height = target.height;
+            }
+            slot.engine.on_update(triangle);
+        }
+
+        // Drop the frames of sizes no longer in use
+        auto kept = std::vector<std::size_t>(scaled.size());
+        auto last = std::size_t{};
+        for (auto k = std::size_t{}; k < scaled.size(); ++k)
+        {
+            kept[k] = last;
+            if (used[k])
+                std::swap(scaled[last++], scaled[k]);
+        }
+        scaled.resize(last);
+        for (auto & slot : slots)
+            slot.frame = kept[slot.frame];
+    }
+
+    auto on_capture(parallel::pool & workers, image::const_view source) -> void
+    {
+        // Thumbnails of the source's size read it in place
+        auto const whole   = sample::whole(source);
+        auto       frames  = std::vector<image::const_view>{};
+        auto       targets = std::vector<image::view>{};
+        for (auto const & f : scaled)
+        {
+            auto const is_source = f.width() == source.width && f.height() == source.height;
+            frames.push_back(is_source ? source : f.const_view());
+            targets.push_back(is_source ? image::view{} : f.view());
+        }
+
+        bands(
+            workers, targets,
+            [&](std::size_t k, image::rect const & area)
+            {
+                auto const target = targets[k];
+                for (auto y = area.top; y < area.bottom; ++y)
+                {
+                    auto line = target.row(y);
+                    for (auto x = 0u; x < target.width; ++x)
+                        line[x] = sample::sample(filter, whole, fold::texcoord(x, y, target.width, target.height));
+                }
+            }
+        );
+        workers.run(slots.size(), [&](std::size_t i) { slots[i].engine.on_capture(frames[slots[i].frame]); });
+    }
+
+    // All thumbnails.
+    auto on_render(parallel::pool & workers) const -> void
+    {
+        auto targets = std::vector<image::view>{};
+        for (auto const & thumbnail : items)
+            targets.push_back(thumbnail.target);
+
+        bands(
+            workers, targets,
+            [&](std::size_t i, image::rect const & area) { slots[i].engine.on_render(targets[i], area); }
+        );
+    }
+
+    // Bytes of the runs of all thumbnails and of the shared frames, for
+    // diagnostics.
+    auto footprint() const -> std::size_t
+    {
+        auto total = std::size_t{};
+        for (auto const & slot : slots)
+            total += slot.engine.footprint();
+        for (auto const & f : scaled)
+            total += f.stride() * f.height() * sizeof(image::pixel);
+        return total;
+    }
+
+private:
+    auto static constexpr rows = 16u;
+
+    // "render(k, area)" for every band of about "rows" rows of every target
+    // "k", as "parallel::render" deals out the bands of one.
+    template <typename R>
+    auto static bands(parallel::pool & workers, std::span<image::view const> targets, R const & render) -> void
+    {
+        // "first[k]" is the first band of target k
+        auto first = std::vector<std::size_t>{0};
+        auto sizes = std::vector<std::uint32_t>{};
+        for (auto const & target : targets)
+        {
+            sizes.push_back(parallel::aligned_rows(target, rows));
+            first.push_back(first.back() + (target.height + sizes.back() - 1) / sizes.back());
+        }
+
+        workers.run(
+            first.back(),
+            [&](std::size_t index)
+            {
+                auto const after  = std::upper_bound(first.begin(), first.end(), index);
+                auto const k      = static_cast<std::size_t>(after - first.begin()) - 1;
+                auto const top    = static_cast<std::uint32_t>(index - first[k]) * sizes[k];
+                auto const bottom = std::min(top + sizes[k], targets[k].height);
+                render(k, image::rect{0, top, targets[k].width, bottom});
+            }
+        );
+    }
+
+    // The engine of a thumbnail, the size it was planned for, and its frame
+    // in "scaled".
+    struct slot
+    {
+        scanline      engine;
+        std::uint32_t width{};
+        std::uint32_t height{};
+        std::size_t   frame{};
+    };
+
+    // Inputs
+    sample::filter    filter;
+    staging::mode     how;
+    std::vector<item> items{};
+
+    // Derived, one per item and one per size
+    std::vector<slot>         slots{};
+    std::vector<image::frame> scaled{};
+};
+} // namespace engine
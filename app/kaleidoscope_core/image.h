@@ -0,0 +1,219 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace image
+{
+
+// One pixel of DXGI_FORMAT_B8G8R8A8_UNORM, i.e. 0xAARRGGBB on little endian
+// machines. Channels are always handled as a whole 32-bit word unless a
+// kernel needs to filter them.
+using pixel = std::uint32_t;
+
+// Rows are padded to a multiple of a cache line, so that two threads writing
+// neighbouring rows never touch the same line.
+auto inline constexpr cache_line = std::size_t{64};
+
+// A half-open rectangle [left, right) x [top, bottom), same as RECT.
+struct rect
+{
+    std::uint32_t left;
+    std::uint32_t top;
+    std::uint32_t right;
+    std::uint32_t bottom;
+
+    auto width() const -> std::uint32_t
+    {
+        return right > left ? right - left : 0;
+    }
+
+    auto height() const -> std::uint32_t
+    {
+        return bottom > top ? bottom - top : 0;
+    }
+
+    auto empty() const -> bool
+    {
+        return width() == 0 || height() == 0;
+    }
+};
+
+auto inline intersect(rect const & a, rect const & b) -> rect
+{
+    return {std::max(a.left, b.left), std::max(a.top, b.top), std::min(a.right, b.right), std::min(a.bottom, b.bottom)};
+}
+
+// Smallest rect that covers [left, right] x [top, bottom], clamped to non-negative.
+auto inline enclose(float left, float top, float right, float bottom) -> rect
+{
+    auto to = [](float v) { return static_cast<std::uint32_t>(std::clamp(v, 0.f, 4294967040.f)); };
+    return {to(std::floor(left)), to(std::floor(top)), to(std::ceil(right) + 1.f), to(std::ceil(bottom) + 1.f)};
+}
+
+// Non-owning 2D view. "stride" is counted in elements, not bytes.
+template <typename T> struct basic_view
+{
+    T *           data{};
+    std::uint32_t width{};
+    std::uint32_t height{};
+    std::size_t   stride{};
+
+    basic_view() = default;
+
+    basic_view(T * data, std::uint32_t width, std::uint32_t height, std::size_t stride)
+        : data(data)
+        , width(width)
+        , height(height)
+        , stride(stride)
+    {}
+
+    template <typename U>
+        requires std::is_convertible_v<U *, T *>
+    basic_view(basic_view<U> const & other)
+        : data(other.data)
+        , width(other.width)
+        , height(other.height)
+        , stride(other.stride)
+    {}
+
+    auto row(std::uint32_t y) const -> T *
+    {
+        return data + y * stride;
+    }
+
+    auto at(std::uint32_t x, std::uint32_t y) const -> T &
+    {
+        return row(y)[x];
+    }
+
+    auto bounds() const -> rect
+    {
+        return {0, 0, width, height};
+    }
+
+    auto sub(rect const & area) const -> basic_view
+    {
+        auto r = intersect(area, bounds());
+        return {row(r.top) + r.left, r.width(), r.height(), stride};
+    }
+};
+
+using view       = basic_view<pixel>;
+using const_view = basic_view<pixel const>;
+
+// Cache line aligned storage for pixels, tables and other plain data.
+template <typename T> class buffer
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    struct deleter
+    {
+        auto operator()(T * p) const -> void
+        {
+            ::operator delete[](p, std::align_val_t{cache_line});
+        }
+    };
+
+public:
+    buffer() = default;
+
+    explicit buffer(std::size_t count)
+    {
+        resize(count);
+    }
+
+    auto resize(std::size_t count) -> void
+    {
+        if (count == length)
+            return;
+
+        auto bytes = std::max(count * sizeof(T), std::size_t{1});
+        memory.reset(static_cast<T *>(::operator new[](bytes, std::align_val_t{cache_line})));
+        length = count;
+    }
+
+    auto clear() -> void
+    {
+        if (length != 0)
+            std::memset(memory.get(), 0, length * sizeof(T));
+    }
+
+    auto data() const -> T *
+    {
+        return memory.get();
+    }
+
+    auto size() const -> std::size_t
+    {
+        return length;
+    }
+
+    auto operator[](std::size_t index) const -> T &
+    {
+        return memory.get()[index];
+    }
+
+private:
+    std::unique_ptr<T[], deleter> memory{};
+    std::size_t                   length{};
+};
+
+// Owning BGRA8 image.
+class frame
+{
+public:
+    frame() = default;
+
+    frame(std::uint32_t width, std::uint32_t height)
+    {
+        resize(width, height);
+    }
+
+    auto resize(std::uint32_t width, std::uint32_t height) -> void
+    {
+        auto constexpr align = cache_line / sizeof(pixel);
+        w                    = width;
+        h                    = height;
+        s                    = (std::size_t{width} + align - 1) / align * align;
+        pixels.resize(s * h);
+        pixels.clear();
+    }
+
+    auto width() const -> std::uint32_t
+    {
+        return w;
+    }
+
+    auto height() const -> std::uint32_t
+    {
+        return h;
+    }
+
+    auto stride() const -> std::size_t
+    {
+        return s;
+    }
+
+    auto view() const -> image::view
+    {
+        return {pixels.data(), w, h, s};
+    }
+
+    auto const_view() const -> image::const_view
+    {
+        return {pixels.data(), w, h, s};
+    }
+
+private:
+    buffer<pixel> pixels{};
+    std::uint32_t w{};
+    std::uint32_t h{};
+    std::size_t   s{};
+};
+} // namespace image
@@ -0,0 +1,521 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+#include "cpu.h"
+#include "fold.h"
+#include "image.h"
+#include "sample.h"
+#include "simd.h"
+
+namespace kernel
+{
+
+// The pixel shader for every pixel of "region", which lies inside "target".
+KALEIDOSCOPE_INLINE auto direct_area(
+    fold::triangle_constant_buffer const & triangle, sample::window const & source, image::view target,
+    image::rect const & region, sample::filter how
+) -> void
+{
+    auto const corners = fold::corners(triangle);
+    for (auto y = region.top; y < region.bottom; ++y)
+    {
+        auto line = target.row(y);
+        for (auto x = region.left; x < region.right; ++x)
+        {
+            auto o = fold::texcoord(x, y, target.width, target.height);
+            if (fold::is_inside(corners, o))
+                line[x] = 0;
+            else
+                line[x] = sample::sample(how, source, fold::locate(triangle, corners, o));
+        }
+    }
+}
+
+// "direct_area" built for each level of "cpu.h".
+using direct_fn = void (*)(
+    fold::triangle_constant_buffer const &, sample::window const &, image::view, image::rect const &, sample::filter
+);
+
+auto inline direct_baseline(
+    fold::triangle_constant_buffer const & triangle, sample::window const & source, image::view target,
+    image::rect const & region, sample::filter how
+) -> void
+{
+    direct_area(triangle, source, target, region, how);
+}
+
+KALEIDOSCOPE_TARGET_SSE42 auto inline direct_sse42(
+    fold::triangle_constant_buffer const & triangle, sample::window const & source, image::view target,
+    image::rect const & region, sample::filter how
+) -> void
+{
+    direct_area(triangle, source, target, region, how);
+}
+
+KALEIDOSCOPE_TARGET_AVX2 auto inline direct_avx2(
+    fold::triangle_constant_buffer const & triangle, sample::window const & source, image::view target,
+    image::rect const & region, sample::filter how
+) -> void
+{
+    direct_area(triangle, source, target, region, how);
+}
+
+KALEIDOSCOPE_TARGET_AVX512 auto inline direct_avx512(
+    fold::triangle_constant_buffer const & triangle, sample::window const & source, image::view target,
+    image::rect const & region, sample::filter how
+) -> void
+{
+    direct_area(triangle, source, target, region, how);
+}
+
+auto inline constexpr direct_variants =
+    cpu::variants<direct_fn>{direct_baseline, direct_sse42, direct_avx2, direct_avx512};
+
+// Evaluate the pixel shader for every pixel of "area" in "target".
+//
+// "triangle" is normalized by the size of "target", just like the constant
+// buffer is normalized by the window size. "source" may have any size, as
+// the shader samples it with normalized coordinates, and may be a cropped
+// part of the screenshot as long as it holds every texel the fold reads.
+auto inline direct(
+    fold::triangle_constant_buffer const & triangle, sample::window const & source, image::view target,
+    image::rect const & area, sample::filter how = sample::filter::linear
+) -> void
+{
+    direct_variants.pick()(triangle, source, target, image::intersect(area, target.bounds()), how);
+}
+
+auto inline direct(
+    fold::triangle_constant_buffer const & triangle, image::const_view source, image::view target,
+    image::rect const & area
+) -> void
+{
+    direct(triangle, sample::whole(source), target, area);
+}
+
+auto inline direct(fold::triangle_constant_buffer const & triangle, image::const_view source, image::view target)
+    -> void
+{
+    direct(triangle, sample::whole(source), target, target.bounds());
+}
+
+// Fixed-point texel coordinates used by the stepping kernels below.
+auto inline constexpr fraction_bits = 16;
+auto inline constexpr fraction_one  = std::int32_t{1} << fraction_bits;
+
+// 16.16 -> tap and 8-bit weight, rounded like "sample::resolve".
+auto inline constexpr to_subtexel(std::int32_t v) -> std::int32_t
+{
+    auto constexpr shift = fraction_bits - sample::subtexel_bits;
+    return (v + (1 << (shift - 1))) >> shift;
+}
+
+// 16.16 -> the nearest texel, rounded like "sample::nearest".
+auto inline constexpr to_texel(std::int32_t v) -> std::int32_t
+{
+    return (to_subtexel(v) + sample::subtexel_one / 2) >> sample::subtexel_bits;
+}
+
+// Bilinear samples along a row: the source point starts at texel (x, y) and
+// moves one texel right per output pixel, so weights stay the same across
+// the run and both source rows are read contiguously.
+KALEIDOSCOPE_INLINE auto forward_run(
+    image::pixel const * r0, std::size_t stride, std::uint32_t fx, std::uint32_t fy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+    auto const r1 = r0 + stride;
+
+    auto i = std::uint32_t{};
+#ifdef KALEIDOSCOPE_SSE2
+    auto const vx = _mm_set1_epi32(static_cast<int>(fx));
+    auto const vy = _mm_set1_epi32(static_cast<int>(fy));
+    for (; i + 4 <= count; i += 4)
+    {
+        auto a = _mm_loadu_si128(reinterpret_cast<__m128i const *>(r0 + i));
+        auto b = _mm_loadu_si128(reinterpret_cast<__m128i const *>(r0 + i + 1));
+        auto c = _mm_loadu_si128(reinterpret_cast<__m128i const *>(r1 + i));
+        auto d = _mm_loadu_si128(reinterpret_cast<__m128i const *>(r1 + i + 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), simd::blend4(a, b, c, d, vx, vy));
+    }
+#endif
+    for (; i < count; ++i)
+        out[i] = sample::blend(r0[i], r0[i + 1], r1[i], r1[i + 1], fx, fy);
+}
+
+#ifdef KALEIDOSCOPE_X86
+// 8 pixels per iteration.
+KALEIDOSCOPE_TARGET_AVX2 auto inline forward_run_avx2(
+    image::pixel const * r0, std::size_t stride, std::uint32_t fx, std::uint32_t fy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+    auto const r1 = r0 + stride;
+    auto const vx = _mm256_set1_epi32(static_cast<int>(fx));
+    auto const vy = _mm256_set1_epi32(static_cast<int>(fy));
+
+    auto i = std::uint32_t{};
+    for (; i + 8 <= count; i += 8)
+    {
+        auto a = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(r0 + i));
+        auto b = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(r0 + i + 1));
+        auto c = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(r1 + i));
+        auto d = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(r1 + i + 1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), simd::blend8(a, b, c, d, vx, vy));
+    }
+    forward_run(r0 + i, stride, fx, fy, out + i, count - i);
+}
+
+// 16 pixels per iteration.
+KALEIDOSCOPE_TARGET_AVX512 auto inline forward_run_avx512(
+    image::pixel const * r0, std::size_t stride, std::uint32_t fx, std::uint32_t fy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+    auto const r1 = r0 + stride;
+    auto const vx = _mm512_set1_epi32(static_cast<int>(fx));
+    auto const vy = _mm512_set1_epi32(static_cast<int>(fy));
+
+    auto i = std::uint32_t{};
+    for (; i + 16 <= count; i += 16)
+    {
+        auto a = _mm512_loadu_si512(r0 + i);
+        auto b = _mm512_loadu_si512(r0 + i + 1);
+        auto c = _mm512_loadu_si512(r1 + i);
+        auto d = _mm512_loadu_si512(r1 + i + 1);
+        _mm512_storeu_si512(out + i, simd::blend16(a, b, c, d, vx, vy));
+    }
+    forward_run(r0 + i, stride, fx, fy, out + i, count - i);
+}
+#endif
+
+// "forward_run" built for each level of "cpu.h".
+using forward_fn =
+    void (*)(image::pixel const *, std::size_t, std::uint32_t, std::uint32_t, image::pixel *, std::uint32_t);
+
+auto inline forward_baseline(
+    image::pixel const * r0, std::size_t stride, std::uint32_t fx, std::uint32_t fy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+    forward_run(r0, stride, fx, fy, out, count);
+}
+
+KALEIDOSCOPE_TARGET_SSE42 auto inline forward_sse42(
+    image::pixel const * r0, std::size_t stride, std::uint32_t fx, std::uint32_t fy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+    forward_run(r0, stride, fx, fy, out, count);
+}
+
+KALEIDOSCOPE_TARGET_AVX2 auto inline forward_avx2(
+    image::pixel const * r0, std::size_t stride, std::uint32_t fx, std::uint32_t fy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+#ifdef KALEIDOSCOPE_X86
+    forward_run_avx2(r0, stride, fx, fy, out, count);
+#else
+    forward_run(r0, stride, fx, fy, out, count);
+#endif
+}
+
+KALEIDOSCOPE_TARGET_AVX512 auto inline forward_avx512(
+    image::pixel const * r0, std::size_t stride, std::uint32_t fx, std::uint32_t fy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+#ifdef KALEIDOSCOPE_X86
+    forward_run_avx512(r0, stride, fx, fy, out, count);
+#else
+    forward_run(r0, stride, fx, fy, out, count);
+#endif
+}
+
+auto inline constexpr forward_variants =
+    cpu::variants<forward_fn>{forward_baseline, forward_sse42, forward_avx2, forward_avx512};
+
+// Bilinear samples along a row, from texel (x, y) in 16.16 fixed point, see
+// "forward_run". If both weights are 0, which is the case for copies of a
+// triangle on the pixel grid, the run is a copy of one source row.
+//
+// All taps must lie inside "source".
+auto inline forward(image::const_view source, std::int32_t x, std::int32_t y, image::pixel * out, std::uint32_t count)
+    -> void
+{
+    auto const qx = to_subtexel(x);
+    auto const qy = to_subtexel(y);
+    auto const fx = static_cast<std::uint32_t>(qx & (sample::subtexel_one - 1));
+    auto const fy = static_cast<std::uint32_t>(qy & (sample::subtexel_one - 1));
+    auto const r0 = source.row(static_cast<std::uint32_t>(qy >> sample::subtexel_bits)) + (qx >> sample::subtexel_bits);
+    if (fx == 0 && fy == 0)
+        std::memcpy(out, r0, count * sizeof(image::pixel));
+    else
+        forward_variants.pick()(r0, source.stride, fx, fy, out, count);
+}
+
+// Clear the inside of the triangle in "region", with the same test as the
+// shader. "width" and "height" are the size "triangle" is normalized by.
+auto inline cut_out(
+    fold::aligned_regular_triangle const & triangle, image::view target, image::rect const & region,
+    std::uint32_t width, std::uint32_t height
+) -> void
+{
+    auto const corners = fold::corners(fold::normalize(triangle, width, height));
+    auto const half    = triangle.length * .5f + 1.f;
+    auto const top     = triangle.top_y - 1.f;
+    auto const bottom  = triangle.top_y + triangle.length * fold::half_sqrt3 + 1.f;
+    auto const bounds  = image::enclose(triangle.top_x - half, top, triangle.top_x + half, bottom);
+
+    auto const inner = image::intersect(region, bounds);
+    for (auto y = inner.top; y < inner.bottom; ++y)
+    {
+        auto line = target.row(y);
+        for (auto x = inner.left; x < inner.right; ++x)
+        {
+            if (fold::is_inside(corners, fold::texcoord(x, y, width, height)))
+                line[x] = 0;
+        }
+    }
+}
+
+// Bilinear samples along any line: the source point starts at texel (x, y)
+// and moves (dx, dy) per output pixel, all in 16.16 fixed point.
+KALEIDOSCOPE_INLINE auto stepped_run(
+    image::const_view source, std::int32_t x, std::int32_t y, std::int32_t dx, std::int32_t dy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+    auto const stride = static_cast<std::ptrdiff_t>(source.stride);
+    auto const at     = [&](std::int32_t qx, std::int32_t qy)
+    { return source.data + (qy >> sample::subtexel_bits) * stride + (qx >> sample::subtexel_bits); };
+
+    auto i = std::uint32_t{};
+#ifdef KALEIDOSCOPE_SSE2
+    // Fetch taps of 4 pixels with scalar loads, then blend them at once.
+    alignas(16) image::pixel a[4], b[4], c[4], d[4], wx[4], wy[4];
+    auto const load = [](image::pixel const * v) { return _mm_load_si128(reinterpret_cast<__m128i const *>(v)); };
+    for (; i + 4 <= count; i += 4)
+    {
+        for (auto k = 0; k < 4; ++k, x += dx, y += dy)
+        {
+            auto qx = to_subtexel(x);
+            auto qy = to_subtexel(y);
+            auto p  = at(qx, qy);
+            a[k]    = p[0];
+            b[k]    = p[1];
+            c[k]    = p[stride];
+            d[k]    = p[stride + 1];
+            wx[k]   = static_cast<image::pixel>(qx & (sample::subtexel_one - 1));
+            wy[k]   = static_cast<image::pixel>(qy & (sample::subtexel_one - 1));
+        }
+
+        auto blended = simd::blend4(load(a), load(b), load(c), load(d), load(wx), load(wy));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), blended);
+    }
+#endif
+    for (; i < count; ++i, x += dx, y += dy)
+    {
+        auto qx = to_subtexel(x);
+        auto qy = to_subtexel(y);
+        auto p  = at(qx, qy);
+        auto fx = static_cast<std::uint32_t>(qx & (sample::subtexel_one - 1));
+        auto fy = static_cast<std::uint32_t>(qy & (sample::subtexel_one - 1));
+        out[i]  = sample::blend(p[0], p[1], p[stride], p[stride + 1], fx, fy);
+    }
+}
+
+#ifdef KALEIDOSCOPE_X86
+// 8 pixels per iteration. The positions of all 8 are stepped in one
+// register, and each gather fetches both taps of a row as one 64-bit word,
+// as in "engine::fold_map".
+KALEIDOSCOPE_TARGET_AVX2 auto inline stepped_run_avx2(
+    image::const_view source, std::int32_t x, std::int32_t y, std::int32_t dx, std::int32_t dy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+    auto constexpr shift = fraction_bits - sample::subtexel_bits;
+
+    auto const top    = reinterpret_cast<long long const *>(source.data);
+    auto const bottom = reinterpret_cast<long long const *>(source.data + source.stride);
+    auto const order  = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    auto const lanes  = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    auto const stride = _mm256_set1_epi32(static_cast<int>(source.stride));
+    auto const half   = _mm256_set1_epi32(1 << (shift - 1));
+    auto const weight = _mm256_set1_epi32(sample::subtexel_one - 1);
+    auto const step_x = _mm256_set1_epi32(dx * 8);
+    auto const step_y = _mm256_set1_epi32(dy * 8);
+
+    auto vx = _mm256_add_epi32(_mm256_set1_epi32(x), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(dx)));
+    auto vy = _mm256_add_epi32(_mm256_set1_epi32(y), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(dy)));
+
+    auto i = std::uint32_t{};
+    for (; i + 8 <= count; i += 8)
+    {
+        auto const qx     = _mm256_srai_epi32(_mm256_add_epi32(vx, half), shift);
+        auto const qy     = _mm256_srai_epi32(_mm256_add_epi32(vy, half), shift);
+        auto const row    = _mm256_mullo_epi32(_mm256_srai_epi32(qy, sample::subtexel_bits), stride);
+        auto const offset = _mm256_add_epi32(row, _mm256_srai_epi32(qx, sample::subtexel_bits));
+
+        auto const o0 = _mm256_castsi256_si128(offset);
+        auto const o1 = _mm256_extracti128_si256(offset, 1);
+        auto const t0 = _mm256_permutevar8x32_epi32(_mm256_i32gather_epi64(top, o0, 4), order);
+        auto const t1 = _mm256_permutevar8x32_epi32(_mm256_i32gather_epi64(top, o1, 4), order);
+        auto const b0 = _mm256_permutevar8x32_epi32(_mm256_i32gather_epi64(bottom, o0, 4), order);
+        auto const b1 = _mm256_permutevar8x32_epi32(_mm256_i32gather_epi64(bottom, o1, 4), order);
+
+        auto const blended = simd::blend8(
+            _mm256_permute2x128_si256(t0, t1, 0x20), _mm256_permute2x128_si256(t0, t1, 0x31),
+            _mm256_permute2x128_si256(b0, b1, 0x20), _mm256_permute2x128_si256(b0, b1, 0x31),
+            _mm256_and_si256(qx, weight), _mm256_and_si256(qy, weight)
+        );
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), blended);
+
+        vx = _mm256_add_epi32(vx, step_x);
+        vy = _mm256_add_epi32(vy, step_y);
+    }
+
+    auto const done = static_cast<std::int32_t>(i);
+    stepped_run(source, x + dx * done, y + dy * done, dx, dy, out + i, count - i);
+}
+
+// 16 pixels per iteration, same as "stepped_run_avx2".
+KALEIDOSCOPE_TARGET_AVX512 auto inline stepped_run_avx512(
+    image::const_view source, std::int32_t x, std::int32_t y, std::int32_t dx, std::int32_t dy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+    auto constexpr shift = fraction_bits - sample::subtexel_bits;
+
+    auto const top    = static_cast<void const *>(source.data);
+    auto const bottom = static_cast<void const *>(source.data + source.stride);
+    auto const evens  = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    auto const odds   = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+    auto const lanes  = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    auto const stride = _mm512_set1_epi32(static_cast<int>(source.stride));
+    auto const half   = _mm512_set1_epi32(1 << (shift - 1));
+    auto const weight = _mm512_set1_epi32(sample::subtexel_one - 1);
+    auto const step_x = _mm512_set1_epi32(dx * 16);
+    auto const step_y = _mm512_set1_epi32(dy * 16);
+
+    auto vx = _mm512_add_epi32(_mm512_set1_epi32(x), _mm512_mullo_epi32(lanes, _mm512_set1_epi32(dx)));
+    auto vy = _mm512_add_epi32(_mm512_set1_epi32(y), _mm512_mullo_epi32(lanes, _mm512_set1_epi32(dy)));
+
+    auto i = std::uint32_t{};
+    for (; i + 16 <= count; i += 16)
+    {
+        auto const qx     = _mm512_srai_epi32(_mm512_add_epi32(vx, half), shift);
+        auto const qy     = _mm512_srai_epi32(_mm512_add_epi32(vy, half), shift);
+        auto const row    = _mm512_mullo_epi32(_mm512_srai_epi32(qy, sample::subtexel_bits), stride);
+        auto const offset = _mm512_add_epi32(row, _mm512_srai_epi32(qx, sample::subtexel_bits));
+
+        auto const o0 = _mm512_castsi512_si256(offset);
+        auto const o1 = _mm512_extracti64x4_epi64(offset, 1);
+        auto const t0 = _mm512_i32gather_epi64(o0, top, 4);
+        auto const t1 = _mm512_i32gather_epi64(o1, top, 4);
+        auto const b0 = _mm512_i32gather_epi64(o0, bottom, 4);
+        auto const b1 = _mm512_i32gather_epi64(o1, bottom, 4);
+
+        auto const blended = simd::blend16(
+            _mm512_permutex2var_epi32(t0, evens, t1), _mm512_permutex2var_epi32(t0, odds, t1),
+            _mm512_permutex2var_epi32(b0, evens, b1), _mm512_permutex2var_epi32(b0, odds, b1),
+            _mm512_and_si512(qx, weight), _mm512_and_si512(qy, weight)
+        );
+        _mm512_storeu_si512(out + i, blended);
+
+        vx = _mm512_add_epi32(vx, step_x);
+        vy = _mm512_add_epi32(vy, step_y);
+    }
+
+    auto const done = static_cast<std::int32_t>(i);
+    stepped_run(source, x + dx * done, y + dy * done, dx, dy, out + i, count - i);
+}
+#endif
+
+// "stepped_run" built for each level of "cpu.h".
+using stepped_fn = void (*)(
+    image::const_view, std::int32_t, std::int32_t, std::int32_t, std::int32_t, image::pixel *, std::uint32_t
+);
+
+auto inline stepped_baseline(
+    image::const_view source, std::int32_t x, std::int32_t y, std::int32_t dx, std::int32_t dy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+    stepped_run(source, x, y, dx, dy, out, count);
+}
+
+KALEIDOSCOPE_TARGET_SSE42 auto inline stepped_sse42(
+    image::const_view source, std::int32_t x, std::int32_t y, std::int32_t dx, std::int32_t dy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+    stepped_run(source, x, y, dx, dy, out, count);
+}
+
+KALEIDOSCOPE_TARGET_AVX2 auto inline stepped_avx2(
+    image::const_view source, std::int32_t x, std::int32_t y, std::int32_t dx, std::int32_t dy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+#ifdef KALEIDOSCOPE_X86
+    stepped_run_avx2(source, x, y, dx, dy, out, count);
+#else
+    stepped_run(source, x, y, dx, dy, out, count);
+#endif
+}
+
+KALEIDOSCOPE_TARGET_AVX512 auto inline stepped_avx512(
+    image::const_view source, std::int32_t x, std::int32_t y, std::int32_t dx, std::int32_t dy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+#ifdef KALEIDOSCOPE_X86
+    stepped_run_avx512(source, x, y, dx, dy, out, count);
+#else
+    stepped_run(source, x, y, dx, dy, out, count);
+#endif
+}
+
+auto inline constexpr stepped_variants =
+    cpu::variants<stepped_fn>{stepped_baseline, stepped_sse42, stepped_avx2, stepped_avx512};
+
+// Bilinear samples along any line, see "stepped_run". Used for the reflected
+// copies, whose rows run diagonally through the source.
+//
+// All taps must lie inside "source".
+auto inline stepped(
+    image::const_view source, std::int32_t x, std::int32_t y, std::int32_t dx, std::int32_t dy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+    stepped_variants.pick()(source, x, y, dx, dy, out, count);
+}
+
+// "forward" with point sampling: the run is a copy of one source row.
+//
+// The texel must lie inside "source", and so must the "count" - 1 after it.
+auto inline forward_point(
+    image::const_view source, std::int32_t x, std::int32_t y, image::pixel * out, std::uint32_t count
+) -> void
+{
+    auto const from = source.row(static_cast<std::uint32_t>(to_texel(y))) + to_texel(x);
+    std::memcpy(out, from, count * sizeof(image::pixel));
+}
+
+// "stepped" with point sampling: one load and one store per pixel, with the
+// fold stepped in fixed point instead of evaluated per pixel.
+//
+// All texels must lie inside "source".
+auto inline stepped_point(
+    image::const_view source, std::int32_t x, std::int32_t y, std::int32_t dx, std::int32_t dy, image::pixel * out,
+    std::uint32_t count
+) -> void
+{
+    auto const stride = static_cast<std::ptrdiff_t>(source.stride);
+    for (auto i = 0u; i < count; ++i, x += dx, y += dy)
+        out[i] = source.data[to_texel(y) * stride + to_texel(x)];
+}
+} // namespace kernel
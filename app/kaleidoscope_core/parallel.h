@@ -0,0 +1,257 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "image.h"
+
+namespace parallel
+{
+
+// A work-stealing pool for data parallel loops.
+//
+// "run" splits [0, count) into one contiguous range per thread. A thread
+// takes work from the front of its own range, and once it runs dry, steals
+// the back half of the largest remaining range of another thread. The
+// calling thread works too, so "pool(1)" runs everything inline.
+class pool
+{
+public:
+    using task_type = std::function<void(std::size_t)>;
+
+public:
+    explicit pool(std::size_t threads = std::max(1u, std::thread::hardware_concurrency()))
+        : lanes(std::max<std::size_t>(threads, 1))
+    {
+        for (auto index = std::size_t{1}; index < lanes.size(); ++index)
+            workers.emplace_back([this, index](std::stop_token token) { serve(token, index); });
+    }
+
+    ~pool()
+    {
+        for (auto & worker : workers)
+            worker.request_stop();
+
+        {
+            auto guard = std::lock_guard{lock};
+            ++generation;
+        }
+        wakeup.notify_all();
+
+        // Join before the members they use are destroyed
+        workers.clear();
+    }
+
+    pool(pool const &)             = delete;
+    pool & operator=(pool const &) = delete;
+
+    auto size() const -> std::size_t
+    {
+        return lanes.size();
+    }
+
+    // Call "task(i)" for every i in [0, count), return when all are done.
+    // Not reentrant: only one "run" at a time.
+    auto run(std::size_t count, task_type const & task) -> void
+    {
+        if (count == 0)
+            return;
+
+        // Deal out contiguous ranges
+        auto const n = lanes.size();
+        for (auto index = std::size_t{}; index < n; ++index)
+        {
+            auto guard         = std::lock_guard{lanes[index].lock};
+            lanes[index].begin = count * index / n;
+            lanes[index].end   = count * (index + 1) / n;
+        }
+
+        {
+            auto guard = std::lock_guard{lock};
+            job        = &task;
+            pending.store(count, std::memory_order_relaxed);
+            ++generation;
+        }
+        wakeup.notify_all();
+
+        work(0, task);
+
+        // Wait for other threads still running their last item
+        auto guard = std::unique_lock{lock};
+        finished.wait(guard, [this] { return pending.load(std::memory_order_acquire) == 0 && active == 0; });
+        job = nullptr;
+    }
+
+private:
+    // One per thread, on its own cache line.
+    struct alignas(image::cache_line) lane
+    {
+        std::mutex  lock;
+        std::size_t begin{};
+        std::size_t end{};
+    };
+
+    auto serve(std::stop_token token, std::size_t index) -> void
+    {
+        auto seen = std::uint64_t{};
+        while (true)
+        {
+            auto task = static_cast<task_type const *>(nullptr);
+            {
+                auto guard = std::unique_lock{lock};
+                wakeup.wait(guard, [&] { return generation != seen || token.stop_requested(); });
+                if (token.stop_requested())
+                    return;
+
+                seen = generation;
+                task = job;
+                if (task == nullptr)
+                    continue;
+
+                // Keeps "run" from returning while this thread still holds "task"
+                ++active;
+            }
+
+            work(index, *task);
+
+            auto guard = std::lock_guard{lock};
+            if (--active == 0)
+                finished.notify_all();
+        }
+    }
+
+    auto work(std::size_t index, task_type const & task) -> void
+    {
+        for (auto item = std::size_t{}; take(index, item) || steal(index, item);)
+        {
+            task(item);
+            if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                auto guard = std::lock_guard{lock};
+                finished.notify_all();
+            }
+        }
+    }
+
+    auto take(std::size_t index, std::size_t & item) -> bool
+    {
+        auto & own   = lanes[index];
+        auto   guard = std::lock_guard{own.lock};
+        if (own.begin == own.end)
+            return false;
+
+        item = own.begin++;
+        return true;
+    }
+
+    auto steal(std::size_t index, std::size_t & item) -> bool
+    {
+        // Pick the victim with the most work left
+        auto victim = index;
+        auto most   = std::size_t{};
+        for (auto other = std::size_t{}; other < lanes.size(); ++other)
+        {
+            if (other == index)
+                continue;
+
+            auto guard = std::lock_guard{lanes[other].lock};
+            if (auto left = lanes[other].end - lanes[other].begin; left > most)
+            {
+                victim = other;
+                most   = left;
+            }
+        }
+
+        if (victim == index)
+            return false;
+
+        // Move the back half of its range into ours, then take one
+        auto & from = lanes[victim];
+        auto & into = lanes[index];
+        {
+            auto guard = std::scoped_lock{from.lock, into.lock};
+            if (from.begin == from.end)
+                return steal(index, item);
+
+            auto half  = (from.end - from.begin + 1) / 2;
+            into.begin = from.end - half;
+            into.end   = from.end;
+            from.end   = into.begin;
+        }
+        return take(index, item);
+    }
+
+private:
+    std::vector<lane>         lanes;
+    std::vector<std::jthread> workers{};
+
+    std::mutex               lock{};
+    std::condition_variable  wakeup{};
+    std::condition_variable  finished{};
+    std::uint64_t            generation{};
+    std::size_t              active{};
+    task_type const *        job{};
+    std::atomic<std::size_t> pending{};
+};
+
+// Anything that can render an area of a frame from const methods.
+template <typename E>
+concept renderer = requires(E const & e, image::view target, image::rect const & area) {
+    {
+        e.on_render(target, area)
+    };
+};
+
+// Rows per band so that two bands never share a cache line of "target".
+auto inline aligned_rows(image::view target, std::uint32_t rows) -> std::uint32_t
+{
+    auto const bytes = target.stride * sizeof(image::pixel);
+    auto const step  = static_cast<std::uint32_t>(image::cache_line / std::gcd(bytes, image::cache_line));
+    return std::max((rows + step - 1) / step * step, step);
+}
+
+// Render "area" of "target" with all threads of "workers", in horizontal
+// bands of about "rows" rows. Bands span whole rows, and their first rows
+// are cache line aligned whenever "target" itself is (as "image::frame" is).
+template <renderer E>
+auto render(pool & workers, E const & engine, image::view target, image::rect const & area, std::uint32_t rows = 16)
+    -> void
+{
+    auto const region = image::intersect(area, target.bounds());
+    if (region.empty())
+        return;
+
+    auto const band  = aligned_rows(target, rows);
+    auto const count = (region.height() + band - 1) / band;
+    workers.run(
+        count,
+        [&](std::size_t index)
+        {
+            auto top    = region.top + static_cast<std::uint32_t>(index) * band;
+            auto bottom = std::min(top + band, region.bottom);
+            engine.on_render(target, {region.left, top, region.right, bottom});
+        }
+    );
+}
+
+template <renderer E> auto render(pool & workers, E const & engine, image::view target) -> void
+{
+    render(workers, engine, target, target.bounds());
+}
+
+// Render a list of areas, one task each, e.g. the runs of "dirty::tracker".
+// Areas must not overlap, and should not share cache lines.
+template <renderer E>
+auto render(pool & workers, E const & engine, image::view target, std::span<image::rect const> areas) -> void
+{
+    workers.run(areas.size(), [&](std::size_t index) { engine.on_render(target, areas[index]); });
+}
+} // namespace parallel
@@ -0,0 +1,236 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "fold.h"
+#include "image.h"
+#include "sample.h"
+
+namespace staging
+{
+
+// What an engine keeps of every captured frame.
+//
+// The block modes store the patch in blocks of 8 x 8 texels, so that a fold
+// reading the source along a diagonal, as the reflected copies do, stays in
+// a few cache lines instead of touching a new row for every pixel. Engines
+// that can't address blocks, or have no use for turned copies, treat these
+// modes as "crop".
+enum class mode
+{
+    full,    // read the source in place
+    crop,    // copy the triangle's bounding box into a "patch" and read that
+    blocks,  // same as crop, in blocks, row by row
+    morton,  // same as crop, in blocks, in Z order
+    rotated, // same as crop, plus copies turned by +-120 degrees, see "engine::tile_builder"
+};
+
+auto inline is_cropped(mode how) -> bool
+{
+    return how != mode::full;
+}
+
+// Source texels the fold reads for a triangle given in output pixels, from
+// a source that has "scale_x" x "scale_y" texels per output pixel: the
+// triangle's bounding box plus a margin for the bilinear taps. It may leave
+// the source on any side.
+struct region
+{
+    auto static constexpr margin = 2;
+
+    std::int32_t  left{};
+    std::int32_t  top{};
+    std::uint32_t width{};
+    std::uint32_t height{};
+};
+
+auto inline bounds(fold::aligned_regular_triangle const & t, double scale_x, double scale_y) -> region
+{
+    auto const height = t.length * fold::half_sqrt3;
+    auto const left   = (t.top_x - t.length * .5) * scale_x - .5;
+    auto const right  = (t.top_x + t.length * .5) * scale_x - .5;
+    auto const top    = t.top_y * scale_y - .5;
+    auto const bottom = (t.top_y + height) * scale_y - .5;
+
+    auto constexpr margin = region::margin;
+    return {
+        static_cast<std::int32_t>(std::floor(left)) - margin,
+        static_cast<std::int32_t>(std::floor(top)) - margin,
+        static_cast<std::uint32_t>(std::ceil(right) - std::floor(left)) + 2 * margin + 1,
+        static_cast<std::uint32_t>(std::ceil(bottom) - std::floor(top)) + 2 * margin + 1,
+    };
+}
+
+// The "region" of a source image, copied once per frame into a compact
+// buffer, padded with transparent black wherever it leaves the source, so
+// that kernels reading it never need a bounds check.
+//
+// In the block modes each block holds 7 x 7 texels of its own plus a copy
+// of the first column and row of its neighbours to the right and below, so
+// that all 4 taps of any texel are in one block, 1 and "block" apart. A
+// block is 4 cache lines.
+class patch
+{
+public:
+    auto static constexpr block = 8u;         // side of a block, in texels
+    auto static constexpr inner = block - 1u; // texels of its own per side
+
+public:
+    explicit patch(mode how = mode::crop)
+        : how(how)
+    {}
+
+    auto on_update(fold::aligned_regular_triangle const & t, double scale_x, double scale_y) -> void
+    {
+        auto const r = bounds(t, scale_x, scale_y);
+        x            = r.left;
+        y            = r.top;
+        width        = r.width;
+        height       = r.height;
+        if (!is_blocked())
+        {
+            pixels.resize(r.width, r.height);
+            return;
+        }
+
+        columns         = (width + inner - 1) / inner;
+        rows            = (height + inner - 1) / inner;
+        auto const last = index(columns - 1, rows - 1);
+        blocks.resize((std::size_t{last} + 1) * block * block);
+    }
+
+    auto on_capture(image::const_view source) -> void
+    {
+        if (!is_blocked())
+        {
+            auto const target = pixels.view();
+            for (auto row = 0u; row < target.height; ++row)
+                copy(source, y + static_cast<std::int32_t>(row), target.row(row), target.width);
+            return;
+        }
+
+        // Each row of texels once, then into every block that holds it
+        auto const span = columns * inner + 1;
+        line.resize(span);
+        for (auto row = 0u; row < rows * inner + 1; ++row)
+        {
+            copy(source, y + static_cast<std::int32_t>(row), line.data(), span);
+            auto const by = row / inner;
+            auto const in = row % inner;
+            if (by < rows)
+                scatter(by, in);
+            if (in == 0 && by > 0)
+                scatter(by - 1, inner);
+        }
+    }
+
+    // Texels, rows of the bounding box in "mode::crop". In the block modes
+    // "stride" is that of a block, and texel (x, y) is at "offset(x, y)".
+    auto view() const -> image::const_view
+    {
+        if (!is_blocked())
+            return pixels.const_view();
+        return {blocks.data(), width, height, block};
+    }
+
+    // Of patch texel (x, y) in "view".
+    auto offset(std::uint32_t px, std::uint32_t py) const -> std::uint32_t
+    {
+        if (!is_blocked())
+            return static_cast<std::uint32_t>(py * pixels.stride() + px);
+        return index(px / inner, py / inner) * block * block + py % inner * block + px % inner;
+    }
+
+    // Source texel of patch texel (0, 0). May be negative.
+    auto left() const -> std::int32_t
+    {
+        return x;
+    }
+
+    auto top() const -> std::int32_t
+    {
+        return y;
+    }
+
+    // The patch as a part of a source of "width" x "height", "mode::crop"
+    // only.
+    auto window(std::uint32_t source_width, std::uint32_t source_height) const -> sample::window
+    {
+        return {pixels.const_view(), x, y, source_width, source_height};
+    }
+
+private:
+    auto is_blocked() const -> bool
+    {
+        return how == mode::blocks || how == mode::morton;
+    }
+
+    // Of block (bx, by).
+    auto index(std::uint32_t bx, std::uint32_t by) const -> std::uint32_t
+    {
+        if (how != mode::morton)
+            return by * columns + bx;
+
+        // Bits of bx at even positions and of by at odd ones
+        auto const spread = [](std::uint32_t v)
+        {
+            v = (v | v << 8) & 0x00ff00ffu;
+            v = (v | v << 4) & 0x0f0f0f0fu;
+            v = (v | v << 2) & 0x33333333u;
+            v = (v | v << 1) & 0x55555555u;
+            return v;
+        };
+        return spread(bx) | spread(by) << 1;
+    }
+
+    // "count" texels of source row "sy" from column "x" on, black outside
+    // the source.
+    auto copy(image::const_view source, std::int32_t sy, image::pixel * out, std::uint32_t count) const -> void
+    {
+        auto const w     = static_cast<std::int32_t>(source.width);
+        auto const h     = static_cast<std::int32_t>(source.height);
+        auto const from  = std::clamp(x, 0, w);
+        auto const until = std::clamp(x + static_cast<std::int32_t>(count), 0, w);
+        if (sy < 0 || sy >= h || from >= until)
+        {
+            std::memset(out, 0, count * sizeof(image::pixel));
+            return;
+        }
+
+        auto head = static_cast<std::uint32_t>(from - x);
+        auto body = static_cast<std::uint32_t>(until - from);
+        std::memset(out, 0, head * sizeof(image::pixel));
+        std::memcpy(out + head, source.row(static_cast<std::uint32_t>(sy)) + from, body * sizeof(image::pixel));
+        std::memset(out + head + body, 0, (count - head - body) * sizeof(image::pixel));
+    }
+
+    // "line" into row "in" of the blocks of block row "by".
+    auto scatter(std::uint32_t by, std::uint32_t in) -> void
+    {
+        for (auto bx = 0u; bx < columns; ++bx)
+        {
+            auto const into = blocks.data() + std::size_t{index(bx, by)} * block * block + in * block;
+            std::memcpy(into, line.data() + bx * inner, block * sizeof(image::pixel));
+        }
+    }
+
+private:
+    mode         how;
+    std::int32_t x{};
+    std::int32_t y{};
+
+    // Rows
+    image::frame pixels{};
+
+    // Blocks
+    std::uint32_t               width{};
+    std::uint32_t               height{};
+    std::uint32_t               columns{}; // of blocks
+    std::uint32_t               rows{};
+    image::buffer<image::pixel> blocks{};
+    std::vector<image::pixel>   line{}; // one row of texels, before it is split
+};
+} // namespace staging
@@ -0,0 +1,142 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "fold.h"
+#include "image.h"
+#include "kernel.h"
+#include "patch.h"
+#include "sample.h"
+#include "tile_builder.h"
+
+namespace engine
+{
+
+// Render one period of the pattern and replicate it.
+//
+// "redirect" makes the output periodic with a 3 * length x 2 * height tile.
+// Horizontally the period is 3 * length output pixels, an integer for the
+// integer side lengths the viewmodel produces, so each row only evaluates
+// the fold for one period and fills the rest with doubling row copies.
+//
+// Vertically the period is sqrt(3) * length pixels, which never lands on the
+// pixel grid, so rows are not replicated: every row evaluates its own period.
+//
+// The triangle itself is not periodic, it is cut out after replication.
+class period_tile
+{
+public:
+    // How to evaluate the period of each row.
+    enum class method
+    {
+        fold,       // run the shader's fold for every pixel
+        reflection, // copy and reflect the source triangle, see "tile_builder"
+    };
+
+public:
+    // "stage" is that of "tile_builder", for "method::reflection".
+    explicit period_tile(
+        method how = method::reflection, sample::filter filter = sample::filter::linear,
+        staging::mode stage = staging::mode::crop
+    )
+        : how(how)
+        , filter(filter)
+        , builder(filter, stage)
+    {}
+
+    auto on_resize(std::uint32_t width, std::uint32_t height) -> void
+    {
+        output_width  = width;
+        output_height = height;
+        builder.on_resize(width, height);
+        refresh();
+    }
+
+    auto on_update(fold::aligned_regular_triangle const & triangle) -> void
+    {
+        current = triangle;
+        builder.on_update(triangle);
+        refresh();
+    }
+
+    auto on_capture(image::const_view source) -> void
+    {
+        screenshot = source;
+        if (how == method::reflection)
+            builder.on_capture(source);
+    }
+
+    auto on_render(image::view target, image::rect const & area) const -> void
+    {
+        auto const output = image::rect{0, 0, output_width, output_height};
+        auto const region = image::intersect(area, image::intersect(target.bounds(), output));
+        if (region.empty())
+            return;
+
+        // Fall back to one evaluation per pixel if nothing can be replicated.
+        auto const span = period != 0 && period < region.width() ? period : region.width();
+
+        if (how == method::reflection)
+            builder.build(target, {region.left, region.top, region.left + span, region.bottom});
+
+        for (auto y = region.top; y < region.bottom; ++y)
+        {
+            auto line = target.row(y);
+            for (auto x = region.left; how == method::fold && x < region.left + span; ++x)
+            {
+                auto o  = fold::texcoord(x, y, output_width, output_height);
+                line[x] = sample::sample(filter, sample::whole(screenshot), fold::locate(triangle, corners, o));
+            }
+
+            // Double the copied range each time, so a row takes log2(width / period) copies.
+            for (auto done = span; done < region.width();)
+            {
+                auto count = std::min(done, region.width() - done);
+                std::memcpy(line + region.left + done, line + region.left, count * sizeof(image::pixel));
+                done += count;
+            }
+        }
+
+        kernel::cut_out(current, target, region, output_width, output_height);
+    }
+
+    auto on_render(image::view target) const -> void
+    {
+        on_render(target, target.bounds());
+    }
+
+    // Bytes of the runs of "tile_builder", for diagnostics.
+    auto footprint() const -> std::size_t
+    {
+        return how == method::reflection ? builder.footprint() : 0;
+    }
+
+private:
+    auto refresh() -> void
+    {
+        triangle = fold::normalize(current, output_width, output_height);
+        corners  = fold::corners(triangle);
+
+        // Only replicate if the period is a whole number of pixels.
+        auto size = 3.f * current.length;
+        period    = size >= 1.f && std::floor(size) == size ? static_cast<std::uint32_t>(size) : 0;
+    }
+
+private:
+    // Inputs
+    method                         how{};
+    sample::filter                 filter{};
+    fold::aligned_regular_triangle current{};
+    std::uint32_t                  output_width{};
+    std::uint32_t                  output_height{};
+    image::const_view              screenshot{};
+
+    // Derived
+    fold::triangle_constant_buffer triangle{};
+    fold::corners                  corners{triangle};
+    std::uint32_t                  period{};
+    tile_builder                   builder{};
+};
+} // namespace engine
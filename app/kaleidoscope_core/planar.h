@@ -0,0 +1,608 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "cpu.h"
+#include "fold.h"
+#include "fold_map.h"
+#include "image.h"
+#include "parallel.h"
+#include "patch.h"
+#include "sample.h"
+#include "simd.h"
+#include "yuv.h"
+
+namespace engine
+{
+
+// "fold_map" straight into the YUV 4:2:0 frames video encoders take, NV12 or
+// I420, instead of rendering BGRA and converting every frame afterwards.
+//
+// Luma and chroma are folded separately, each by a "fold_map" of its own:
+// chroma at half the output's size with the triangle halved, so that each
+// chroma pixel samples the position at the center of its 2 x 2 pixels. Both
+// tables index a patch as in "staging::mode::crop", which here holds one Y,
+// or one pair of U and V, per texel instead of BGRA. From a BGRA capture
+// only the patch is converted, a bounding box of the triangle instead of
+// every output pixel, and from a YUV source it is copied. A frame writes 1.5
+// bytes per output pixel instead of 4, and reads 10 bytes of tables instead
+// of 8.
+//
+// The inside of the triangle shows the source, as a recording of the screen
+// shows it, see "fold_map::on_cut". Blending converted texels rounds
+// differently from converting blended pixels, by a level or two, and chroma
+// is blended at half the resolution, so edges of color are softer than in a
+// frame converted after rendering.
+//
+// A drag by an odd number of pixels moves the chroma triangle by half a
+// texel, which a table can't be shifted by. So chroma keeps a table per
+// phase, whether the triangle's top is on an odd column and row, made when
+// the triangle first gets there, and a drag shifts the one of its phase
+// along. The four take as much memory as the table of luma.
+//
+// Sizes should be even, as rows and columns of 4:2:0 come in pairs.
+class planar
+{
+public:
+    explicit planar(sample::filter filter = sample::filter::linear)
+        : luma(staging::mode::crop, filter)
+        , phases{
+              fold_map(staging::mode::crop, filter),
+              fold_map(staging::mode::crop, filter),
+              fold_map(staging::mode::crop, filter),
+              fold_map(staging::mode::crop, filter),
+          }
+    {
+        luma.on_cut(false);
+        for (auto & map : phases)
+            map.on_cut(false);
+    }
+
+    auto on_resize(std::uint32_t width, std::uint32_t height) -> void
+    {
+        output_width  = width;
+        output_height = height;
+        luma.on_resize(width, height);
+        for (auto & map : phases)
+            map.on_resize((width + 1) / 2, (height + 1) / 2);
+    }
+
+    auto on_update(fold::aligned_regular_triangle const & triangle) -> void
+    {
+        auto const odd = [](float v) { return static_cast<std::size_t>(static_cast<std::int64_t>(std::floor(v)) & 1); };
+        phase          = odd(triangle.top_x) | odd(triangle.top_y) << 1;
+        luma.on_update(triangle);
+        chroma().on_update({triangle.top_x / 2.f, triangle.top_y / 2.f, triangle.length / 2.f});
+    }
+
+    // A BGRA capture, converted as far as the patches reach.
+    auto on_capture(image::const_view source) -> void
+    {
+        build(source.width, source.height);
+
+        auto const columns = source.width / 2;
+        stage(
+            luma, luma_texels, yuv::black_luma, source.width, source.height,
+            [&](std::uint32_t sy, std::uint32_t sx, std::uint8_t * out, std::uint32_t count)
+            { yuv::luma_row(source.row(sy) + sx, out, count); }
+        );
+        stage(
+            chroma(), chroma_texels, yuv::black_chroma, (source.width + 1) / 2, (source.height + 1) / 2,
+            [&](std::uint32_t sy, std::uint32_t sx, std::uint16_t * out, std::uint32_t count)
+            {
+                // An odd last column or row counts its pixels twice
+                auto const r0    = source.row(2 * sy);
+                auto const r1    = source.row(std::min(2 * sy + 1, source.height - 1));
+                auto const whole = std::min(count, columns - std::min(sx, columns));
+                yuv::chroma_row(r0 + 2 * sx, r1 + 2 * sx, out, whole);
+                for (auto i = whole; i < count; ++i)
+                {
+                    auto const last = source.width - 1;
+                    out[i]          = yuv::chroma(r0[last], r0[last], r1[last], r1[last]);
+                }
+            }
+        );
+    }
+
+    // A frame that is YUV already, e.g. from a video decoder, in either
+    // format.
+    auto on_capture(yuv::const_view source) -> void
+    {
+        build(source.width, source.height);
+        stage(
+            luma, luma_texels, yuv::black_luma, source.width, source.height,
+            [&](std::uint32_t sy, std::uint32_t sx, std::uint8_t * out, std::uint32_t count)
+            { std::memcpy(out, source.y + sy * source.y_stride + sx, count); }
+        );
+        stage(
+            chroma(), chroma_texels, yuv::black_chroma, source.chroma_width(), source.chroma_height(),
+            [&](std::uint32_t sy, std::uint32_t sx, std::uint16_t * out, std::uint32_t count)
+            {
+                auto const at = sy * source.uv_stride + std::size_t{sx} * source.step;
+                if (source.is_interleaved())
+                    return static_cast<void>(std::memcpy(out, source.u + at, count * sizeof(std::uint16_t)));
+
+                for (auto i = std::size_t{}, k = at; i < count; ++i, k += source.step)
+                    out[i] = static_cast<std::uint16_t>(source.u[k] | source.v[k] << 8);
+            }
+        );
+    }
+
+    // "area" is in pixels of luma. Areas rendered in parallel must start on
+    // even rows, so that each row of chroma belongs to one of them.
+    auto on_render(yuv::view target, image::rect const & area) const -> void
+    {
+        auto const output = image::rect{0, 0, output_width, output_height};
+        auto const region = image::intersect(area, image::intersect(output, {0, 0, target.width, target.height}));
+        if (region.empty())
+            return;
+
+        auto const luma_rows = luma_variants.pick();
+        auto const y_table   = luma.entries().data();
+        auto const y_stride  = luma.staged().view().stride;
+        for (auto y = region.top; y < region.bottom; ++y)
+        {
+            auto const from = y_table + std::size_t{y} * output_width + region.left;
+            auto const into = target.y + y * target.y_stride + region.left;
+            luma_rows(from, luma_texels.data(), y_stride, into, region.width());
+        }
+
+        // Through a chunk of pairs, which "yuv::store_chroma" lays out
+        auto constexpr chunk       = 256u;
+        auto           pairs       = std::array<std::uint16_t, chunk>{};
+        auto const     chroma_rows = chroma_variants.pick();
+        auto const     uv_table    = chroma().entries().data();
+        auto const     uv_stride   = chroma().staged().view().stride;
+        auto const     uv_width    = (output_width + 1) / 2;
+        auto const     left        = region.left / 2;
+        auto const     right       = (region.right + 1) / 2;
+        for (auto cy = region.top / 2; cy < (region.bottom + 1) / 2; ++cy)
+        {
+            auto const from = uv_table + std::size_t{cy} * uv_width;
+            for (auto cx = left; cx < right; cx += chunk)
+            {
+                auto const count = std::min(chunk, right - cx);
+                chroma_rows(from + cx, chroma_texels.data(), uv_stride, pairs.data(), count);
+                yuv::store_chroma(target, cx, cy, pairs.data(), count);
+            }
+        }
+    }
+
+    auto on_render(yuv::view target) const -> void
+    {
+        on_render(target, {0, 0, target.width, target.height});
+    }
+
+    // With all threads of "workers", in bands of "rows" rows, an even number.
+    auto on_render(parallel::pool & workers, yuv::view target, std::uint32_t rows = 16) const -> void
+    {
+        auto const band  = std::max(2u, rows / 2 * 2);
+        auto const count = (target.height + band - 1) / band;
+        workers.run(
+            count,
+            [&](std::size_t index)
+            {
+                auto const top    = static_cast<std::uint32_t>(index) * band;
+                auto const bottom = std::min(top + band, target.height);
+                on_render(target, {0, top, target.width, bottom});
+            }
+        );
+    }
+
+    // Bytes of all tables and patches, for diagnostics.
+    auto footprint() const -> std::size_t
+    {
+        auto bytes = luma.footprint() + luma_texels.size() + chroma_texels.size() * sizeof(std::uint16_t);
+        for (auto const & map : phases)
+            bytes += map.footprint();
+        return bytes;
+    }
+
+private:
+    using entry = fold_map::entry;
+
+    // Read past the last texel of a patch by the 32-bit gathers of luma.
+    auto static constexpr slack = std::size_t{4};
+
+    auto build(std::uint32_t width, std::uint32_t height) -> void
+    {
+        auto const half_width = (width + 1) / 2;
+        luma.build(width, height, width);
+        chroma().build(half_width, (height + 1) / 2, half_width);
+    }
+
+    // The chroma table of the triangle's phase.
+    auto chroma() -> fold_map &
+    {
+        return phases[phase];
+    }
+
+    auto chroma() const -> fold_map const &
+    {
+        return phases[phase];
+    }
+
+    // The texels of the patch of "map" in a source plane of "width" x
+    // "height": "body(sy, sx, out, count)" writes those of row "sy" from
+    // column "sx" on, "border" the ones outside the source.
+    template <typename T, typename F>
+    auto static stage(
+        fold_map const & map, image::buffer<T> & texels, T border, std::uint32_t width, std::uint32_t height,
+        F const & body
+    ) -> void
+    {
+        auto const & patch  = map.staged();
+        auto const   pixels = patch.view();
+        texels.resize(pixels.stride * pixels.height + slack);
+        std::fill_n(texels.data() + pixels.stride * pixels.height, slack, border);
+
+        auto const w     = static_cast<std::int64_t>(width);
+        auto const h     = static_cast<std::int64_t>(height);
+        auto const from  = static_cast<std::uint32_t>(std::clamp<std::int64_t>(-patch.left(), 0, pixels.width));
+        auto const until = static_cast<std::uint32_t>(std::clamp<std::int64_t>(w - patch.left(), 0, pixels.width));
+        for (auto py = 0u; py < pixels.height; ++py)
+        {
+            auto const out = texels.data() + py * pixels.stride;
+            auto const sy  = std::int64_t{patch.top()} + py;
+            if (sy < 0 || sy >= h || from >= until)
+            {
+                std::fill_n(out, pixels.width, border);
+                continue;
+            }
+
+            std::fill_n(out, from, border);
+            auto const sx = static_cast<std::uint32_t>(patch.left() + static_cast<std::int32_t>(from));
+            body(static_cast<std::uint32_t>(sy), sx, out + from, until - from);
+            std::fill_n(out + until, pixels.width - until, border);
+        }
+    }
+
+    // The texel "e" samples, Y or a pair of U and V, blended channel by
+    // channel as "sample::blend" blends those of a pixel. Missing taps are
+    // black, as in "fold_map::gather_at_border".
+    template <typename T>
+    KALEIDOSCOPE_INLINE auto static gather(T const * texels, std::size_t stride, entry const & e, T border) -> T
+    {
+        auto const s = texels + e.offset;
+        if (e.taps == fold_map::tap::all)
+            return static_cast<T>(sample::blend(s[0], s[1], s[stride], s[stride + 1], e.fx, e.fy));
+        if (e.taps == 0)
+            return border;
+
+        auto const st   = static_cast<std::ptrdiff_t>(stride);
+        auto const dx   = (e.shift & 1) ? std::ptrdiff_t{1} : std::ptrdiff_t{0};
+        auto const dy   = (e.shift & 2) ? st : std::ptrdiff_t{0};
+        auto const base = static_cast<std::ptrdiff_t>(e.offset) - dx - dy;
+        auto const at   = [&](std::uint8_t bit, std::ptrdiff_t offset) -> image::pixel
+        { return (e.taps & bit) ? texels[base + offset] : border; };
+
+        using tap = fold_map::tap;
+        return static_cast<T>(sample::blend(
+            at(tap::top_left, 0), at(tap::top_right, 1), at(tap::bottom_left, st), at(tap::bottom_right, st + 1), e.fx,
+            e.fy
+        ));
+    }
+
+    // "count" pixels of one row, from its first entry. The scalar reference
+    // the vectorized builds below must match.
+    KALEIDOSCOPE_INLINE auto static luma_row(
+        entry const * from, std::uint8_t const * texels, std::size_t stride, std::uint8_t * out, std::uint32_t count
+    ) -> void
+    {
+        for (auto x = 0u; x < count; ++x)
+            out[x] = gather(texels, stride, from[x], yuv::black_luma);
+    }
+
+    KALEIDOSCOPE_INLINE auto static chroma_row(
+        entry const * from, std::uint16_t const * texels, std::size_t stride, std::uint16_t * out, std::uint32_t count
+    ) -> void
+    {
+        for (auto x = 0u; x < count; ++x)
+            out[x] = gather(texels, stride, from[x], yuv::black_chroma);
+    }
+
+    auto static is_plain(entry const * e, std::uint32_t count) -> bool
+    {
+        for (auto i = 0u; i < count; ++i)
+            if (e[i].taps != fold_map::tap::all)
+                return false;
+        return true;
+    }
+
+#ifdef KALEIDOSCOPE_SSE2
+    // 8 pixels per iteration, one "simd::blend2" of 16-bit lanes. Taps are
+    // fetched with scalar loads, as in "fold_map::gather_area_sse2".
+    KALEIDOSCOPE_INLINE auto static luma_row_sse2(
+        entry const * from, std::uint8_t const * texels, std::size_t stride, std::uint8_t * out, std::uint32_t count
+    ) -> void
+    {
+        auto const load = [](std::uint16_t const * v) { return _mm_load_si128(reinterpret_cast<__m128i const *>(v)); };
+
+        alignas(16) std::uint16_t a[8], b[8], c[8], d[8], wx[8], wy[8];
+        auto x = 0u;
+        for (; x + 8 <= count; x += 8)
+        {
+            if (!is_plain(from + x, 8))
+            {
+                luma_row(from + x, texels, stride, out + x, 8);
+                continue;
+            }
+
+            for (auto k = 0u; k < 8; ++k)
+            {
+                auto const & e = from[x + k];
+                auto const   s = texels + e.offset;
+                a[k]           = s[0];
+                b[k]           = s[1];
+                c[k]           = s[stride];
+                d[k]           = s[stride + 1];
+                wx[k]          = e.fx;
+                wy[k]          = e.fy;
+            }
+
+            auto const blended = simd::blend2(load(a), load(b), load(c), load(d), load(wx), load(wy));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + x), _mm_packus_epi16(blended, blended));
+        }
+        luma_row(from + x, texels, stride, out + x, count - x);
+    }
+
+    // 4 pairs per iteration, U and V in neighbouring lanes with the same
+    // weights.
+    KALEIDOSCOPE_INLINE auto static chroma_row_sse2(
+        entry const * from, std::uint16_t const * texels, std::size_t stride, std::uint16_t * out, std::uint32_t count
+    ) -> void
+    {
+        auto const load = [](std::uint16_t const * v) { return _mm_load_si128(reinterpret_cast<__m128i const *>(v)); };
+
+        alignas(16) std::uint16_t a[8], b[8], c[8], d[8], wx[8], wy[8];
+        auto x = 0u;
+        for (; x + 4 <= count; x += 4)
+        {
+            if (!is_plain(from + x, 4))
+            {
+                chroma_row(from + x, texels, stride, out + x, 4);
+                continue;
+            }
+
+            for (auto k = 0u; k < 4; ++k)
+            {
+                auto const & e = from[x + k];
+                auto const   s = texels + e.offset;
+                for (auto shift = 0u, i = 2 * k; shift < 16; shift += 8, ++i)
+                {
+                    a[i]  = (s[0] >> shift) & 0xff;
+                    b[i]  = (s[1] >> shift) & 0xff;
+                    c[i]  = (s[stride] >> shift) & 0xff;
+                    d[i]  = (s[stride + 1] >> shift) & 0xff;
+                    wx[i] = e.fx;
+                    wy[i] = e.fy;
+                }
+            }
+
+            auto const blended = simd::blend2(load(a), load(b), load(c), load(d), load(wx), load(wy));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + x), _mm_packus_epi16(blended, blended));
+        }
+        chroma_row(from + x, texels, stride, out + x, count - x);
+    }
+#endif
+
+#ifdef KALEIDOSCOPE_X86
+    // Offsets and the rest of 8 entries, as "fold_map::gather_area_avx2"
+    // splits them.
+    KALEIDOSCOPE_TARGET_AVX2 auto static split(entry const * from, __m256i & offset, __m256i & meta) -> void
+    {
+        auto const order = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        auto const e0    = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(from));
+        auto const e1    = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(from + 4));
+        auto const p0    = _mm256_permutevar8x32_epi32(e0, order);
+        auto const p1    = _mm256_permutevar8x32_epi32(e1, order);
+        offset           = _mm256_permute2x128_si256(p0, p1, 0x20);
+        meta             = _mm256_permute2x128_si256(p0, p1, 0x31);
+    }
+
+    KALEIDOSCOPE_TARGET_AVX2 auto static is_plain(__m256i meta) -> bool
+    {
+        auto const taps = _mm256_and_si256(_mm256_srli_epi32(meta, 16), _mm256_set1_epi32(0xff));
+        return _mm256_movemask_epi8(_mm256_cmpeq_epi32(taps, _mm256_set1_epi32(fold_map::tap::all))) == -1;
+    }
+
+    // Both taps of a row, as the low and high 16 bits of each 32-bit lane,
+    // weighted by 256 - fx and fx with one multiply-add: the inner sums of
+    // "simd::blend2", exact in 32 bits.
+    KALEIDOSCOPE_TARGET_AVX2 auto static horizontal(__m256i taps, __m256i meta) -> __m256i
+    {
+        auto const fx = _mm256_and_si256(meta, _mm256_set1_epi32(0xff));
+        auto const w  = _mm256_or_si256(_mm256_sub_epi32(_mm256_set1_epi32(256), fx), _mm256_slli_epi32(fx, 16));
+        return _mm256_madd_epi16(taps, w);
+    }
+
+    // Both taps of a row of luma for 8 offsets, the low bytes of 32-bit words
+    // spread to the low and high 16 bits.
+    KALEIDOSCOPE_TARGET_AVX2 auto static luma_taps(int const * base, __m256i offset) -> __m256i
+    {
+        auto const taps = _mm256_i32gather_epi32(base, offset, 1);
+        auto const low  = _mm256_and_si256(taps, _mm256_set1_epi32(0xff));
+        return _mm256_or_si256(low, _mm256_and_si256(_mm256_slli_epi32(taps, 8), _mm256_set1_epi32(0xff0000)));
+    }
+
+    // Both pairs of a row of chroma for 8 offsets, [U V U V] split into U and
+    // V, weighted, and U in the low, V in the high 16 bits again.
+    KALEIDOSCOPE_TARGET_AVX2 auto static chroma_taps(int const * base, __m256i offset, __m256i meta) -> __m256i
+    {
+        auto const bytes = _mm256_set1_epi32(0x00ff00ff);
+        auto const taps  = _mm256_i32gather_epi32(base, offset, 2);
+        auto const u     = horizontal(_mm256_and_si256(taps, bytes), meta);
+        auto const v     = horizontal(_mm256_and_si256(_mm256_srli_epi32(taps, 8), bytes), meta);
+        return _mm256_or_si256(u, _mm256_slli_epi32(v, 16));
+    }
+
+    // 16 pixels per iteration. Each gather fetches both taps of a row of 8
+    // pixels as the low bytes of a 32-bit word, and one "simd::vertical"
+    // finishes two groups of 8, one in the low and one in the high 16 bits
+    // of each lane.
+    KALEIDOSCOPE_TARGET_AVX2 auto static luma_row_avx2(
+        entry const * from, std::uint8_t const * texels, std::size_t stride, std::uint8_t * out, std::uint32_t count
+    ) -> void
+    {
+        auto const top    = reinterpret_cast<int const *>(texels);
+        auto const bottom = reinterpret_cast<int const *>(texels + stride);
+        auto const low    = _mm256_set1_epi32(0xff);
+        auto const high   = _mm256_set1_epi32(0xff0000);
+        auto const word   = _mm256_set1_epi32(0xffff);
+        auto const order  = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+        auto x = 0u;
+        for (; x + 16 <= count; x += 16)
+        {
+            auto o0 = __m256i{}, m0 = __m256i{}, o1 = __m256i{}, m1 = __m256i{};
+            split(from + x, o0, m0);
+            split(from + x + 8, o1, m1);
+            if (!is_plain(m0) || !is_plain(m1))
+            {
+                luma_row(from + x, texels, stride, out + x, 16);
+                continue;
+            }
+
+            auto const h0 = _mm256_or_si256(
+                horizontal(luma_taps(top, o0), m0), _mm256_slli_epi32(horizontal(luma_taps(top, o1), m1), 16)
+            );
+            auto const h1 = _mm256_or_si256(
+                horizontal(luma_taps(bottom, o0), m0), _mm256_slli_epi32(horizontal(luma_taps(bottom, o1), m1), 16)
+            );
+            auto const fy = _mm256_or_si256(
+                _mm256_and_si256(_mm256_srli_epi32(m0, 8), low), _mm256_and_si256(_mm256_slli_epi32(m1, 8), high)
+            );
+            auto const blended = simd::vertical(h0, h1, fy);
+
+            // [pixel i, pixel 8 + i] x 8 -> pixels 0-15
+            auto const words = _mm256_packus_epi32(_mm256_and_si256(blended, word), _mm256_srli_epi32(blended, 16));
+            auto const bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(words, words), order);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), _mm256_castsi256_si128(bytes));
+        }
+        luma_row(from + x, texels, stride, out + x, count - x);
+    }
+
+    // 8 pairs per iteration, each gather fetching both pairs of a row.
+    KALEIDOSCOPE_TARGET_AVX2 auto static chroma_row_avx2(
+        entry const * from, std::uint16_t const * texels, std::size_t stride, std::uint16_t * out, std::uint32_t count
+    ) -> void
+    {
+        auto const top    = reinterpret_cast<int const *>(texels);
+        auto const bottom = reinterpret_cast<int const *>(texels + stride);
+        auto const low    = _mm256_set1_epi32(0xff);
+
+        auto x = 0u;
+        for (; x + 8 <= count; x += 8)
+        {
+            auto offset = __m256i{}, meta = __m256i{};
+            split(from + x, offset, meta);
+            if (!is_plain(meta))
+            {
+                chroma_row(from + x, texels, stride, out + x, 8);
+                continue;
+            }
+
+            auto const fy      = _mm256_and_si256(_mm256_srli_epi32(meta, 8), low);
+            auto const h0      = chroma_taps(top, offset, meta);
+            auto const h1      = chroma_taps(bottom, offset, meta);
+            auto const blended = simd::vertical(h0, h1, _mm256_or_si256(fy, _mm256_slli_epi32(fy, 16)));
+            auto const pairs   = _mm256_permute4x64_epi64(_mm256_packus_epi16(blended, blended), 0x08);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), _mm256_castsi256_si128(pairs));
+        }
+        chroma_row(from + x, texels, stride, out + x, count - x);
+    }
+#endif
+
+    // The rows built for each level of "cpu.h". AVX-512 runs the AVX2
+    // builds: a gather of 8 lanes already fetches both taps of a row.
+    using luma_fn = void (*)(entry const *, std::uint8_t const *, std::size_t, std::uint8_t *, std::uint32_t);
+    using chroma_fn = void (*)(entry const *, std::uint16_t const *, std::size_t, std::uint16_t *, std::uint32_t);
+
+    auto static luma_baseline(
+        entry const * from, std::uint8_t const * texels, std::size_t stride, std::uint8_t * out, std::uint32_t count
+    ) -> void
+    {
+#ifdef KALEIDOSCOPE_SSE2
+        luma_row_sse2(from, texels, stride, out, count);
+#else
+        luma_row(from, texels, stride, out, count);
+#endif
+    }
+
+    KALEIDOSCOPE_TARGET_SSE42 auto static luma_sse42(
+        entry const * from, std::uint8_t const * texels, std::size_t stride, std::uint8_t * out, std::uint32_t count
+    ) -> void
+    {
+#ifdef KALEIDOSCOPE_SSE2
+        luma_row_sse2(from, texels, stride, out, count);
+#else
+        luma_row(from, texels, stride, out, count);
+#endif
+    }
+
+    KALEIDOSCOPE_TARGET_AVX2 auto static luma_avx2(
+        entry const * from, std::uint8_t const * texels, std::size_t stride, std::uint8_t * out, std::uint32_t count
+    ) -> void
+    {
+#ifdef KALEIDOSCOPE_X86
+        luma_row_avx2(from, texels, stride, out, count);
+#else
+        luma_row(from, texels, stride, out, count);
+#endif
+    }
+
+    auto static chroma_baseline(
+        entry const * from, std::uint16_t const * texels, std::size_t stride, std::uint16_t * out, std::uint32_t count
+    ) -> void
+    {
+#ifdef KALEIDOSCOPE_SSE2
+        chroma_row_sse2(from, texels, stride, out, count);
+#else
+        chroma_row(from, texels, stride, out, count);
+#endif
+    }
+
+    KALEIDOSCOPE_TARGET_SSE42 auto static chroma_sse42(
+        entry const * from, std::uint16_t const * texels, std::size_t stride, std::uint16_t * out, std::uint32_t count
+    ) -> void
+    {
+#ifdef KALEIDOSCOPE_SSE2
+        chroma_row_sse2(from, texels, stride, out, count);
+#else
+        chroma_row(from, texels, stride, out, count);
+#endif
+    }
+
+    KALEIDOSCOPE_TARGET_AVX2 auto static chroma_avx2(
+        entry const * from, std::uint16_t const * texels, std::size_t stride, std::uint16_t * out, std::uint32_t count
+    ) -> void
+    {
+#ifdef KALEIDOSCOPE_X86
+        chroma_row_avx2(from, texels, stride, out, count);
+#else
+        chroma_row(from, texels, stride, out, count);
+#endif
+    }
+
+    auto static constexpr luma_variants = cpu::variants<luma_fn>{luma_baseline, luma_sse42, luma_avx2, luma_avx2};
+    auto static constexpr chroma_variants =
+        cpu::variants<chroma_fn>{chroma_baseline, chroma_sse42, chroma_avx2, chroma_avx2};
+
+private:
+    // Inputs
+    std::uint32_t output_width{};
+    std::uint32_t output_height{};
+
+    // Tables, of the output and of chroma at half its size per phase, and
+    // the patches they index
+    fold_map                     luma;
+    std::array<fold_map, 4>      phases;
+    std::size_t                  phase{};
+    image::buffer<std::uint8_t>  luma_texels{};
+    image::buffer<std::uint16_t> chroma_texels{};
+};
+} // namespace engine
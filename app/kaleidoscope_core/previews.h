@@ -0,0 +1,252 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "fold.h"
+#include "image.h"
+#include "parallel.h"
+#include "sample.h"
+#include "simd.h"
+
+// Smaller copies of a frame, e.g. 1080p and 360p previews of a 4K output,
+// reduced from the rows of the frame while they are still in cache.
+
+namespace previews
+{
+
+// Largest side ratio reduced by a box filter: its sums fit in 16 bits.
+auto inline constexpr widest_box = 16u;
+
+// The box filter side if "preview" is the frame shrunk by the same whole
+// number in both directions, else 0: it is then sampled bilinearly.
+auto inline factor(image::const_view frame, image::const_view preview) -> std::uint32_t
+{
+    if (preview.width == 0 || preview.height == 0)
+        return 0;
+
+    auto const f        = frame.width / preview.width;
+    auto const is_whole = f * preview.width == frame.width && f * preview.height == frame.height;
+    return is_whole && f <= widest_box ? f : 0;
+}
+
+// The rows of the frame that row "y" of the preview reads, first and last.
+auto inline footprint(image::const_view frame, image::const_view preview, std::uint32_t y)
+    -> std::pair<std::uint32_t, std::uint32_t>
+{
+    if (auto const f = factor(frame, preview); f != 0)
+        return {y * f, y * f + f - 1};
+
+    auto const uv    = fold::texcoord(0, y, preview.width, preview.height);
+    auto const t     = sample::resolve(uv, frame.width, frame.height);
+    auto const last  = static_cast<std::int32_t>(frame.height) - 1;
+    auto const first = static_cast<std::uint32_t>(std::clamp(t.y, 0, last));
+    return {first, std::min(first + 1, frame.height - 1)};
+}
+
+// Pixels of a preview at half the size, from rows "r0" and "r1" below it,
+// as far as whole iterations go. Returns how many were made.
+auto inline halve(image::pixel const * r0, image::pixel const * r1, image::pixel * out, std::uint32_t width)
+    -> std::uint32_t
+{
+    auto x = 0u;
+#ifdef KALEIDOSCOPE_SSE2
+    // 4 pixels per iteration, from 8 of both rows
+    auto const zero = _mm_setzero_si128();
+    auto const two  = _mm_set1_epi16(2);
+    auto const load = [](image::pixel const * v) { return _mm_loadu_si128(reinterpret_cast<__m128i const *>(v)); };
+    for (; x + 4 <= width; x += 4)
+    {
+        auto const a0 = load(r0 + 2 * x);
+        auto const a1 = load(r0 + 2 * x + 4);
+        auto const b0 = load(r1 + 2 * x);
+        auto const b1 = load(r1 + 2 * x + 4);
+
+        // Columns 0 and 1, 2 and 3, and so on, down both rows
+        auto const s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+        auto const s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+        auto const s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+        auto const s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+        // Then across, rounded
+        auto p0 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+        auto p1 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+        p0      = _mm_srli_epi16(_mm_add_epi16(p0, two), 2);
+        p1      = _mm_srli_epi16(_mm_add_epi16(p1, two), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), _mm_packus_epi16(p0, p1));
+    }
+#endif
+    return x;
+}
+
+// Row "y" of the preview, from the frame.
+auto inline reduce_row(image::const_view frame, image::view preview, std::uint32_t y) -> void
+{
+    auto const f    = factor(frame, preview);
+    auto const line = preview.row(y);
+    if (f == 0)
+    {
+        auto const whole = sample::whole(frame);
+        for (auto x = 0u; x < preview.width; ++x)
+            line[x] = sample::linear(whole, fold::texcoord(x, y, preview.width, preview.height));
+        return;
+    }
+
+    // The most common case, 4K to 1080p, without the sums below
+    if (f == 2)
+    {
+        auto const r0 = frame.row(2 * y);
+        auto const r1 = frame.row(2 * y + 1);
+        for (auto x = halve(r0, r1, line, preview.width); x < preview.width; ++x)
+        {
+            auto out = image::pixel{};
+            for (auto shift = 0u; shift < 32; shift += 8)
+            {
+                auto const channel = [&](image::pixel const * r)
+                { return ((r[2 * x] >> shift) & 0xff) + ((r[2 * x + 1] >> shift) & 0xff); };
+                out |= ((channel(r0) + channel(r1) + 2) >> 2) << shift;
+            }
+            line[x] = out;
+        }
+        return;
+    }
+
+    // Channels summed down the rows, then across, then divided
+    auto const channels = std::size_t{preview.width} * f * 4;
+    auto       sums     = std::vector<std::uint16_t>(channels);
+    for (auto row = y * f; row < y * f + f; ++row)
+    {
+        auto const bytes = reinterpret_cast<std::uint8_t const *>(frame.row(row));
+        auto       k     = std::size_t{};
+#ifdef KALEIDOSCOPE_SSE2
+        auto const zero = _mm_setzero_si128();
+        for (; k + 16 <= channels; k += 16)
+        {
+            auto const v    = _mm_loadu_si128(reinterpret_cast<__m128i const *>(bytes + k));
+            auto const low  = reinterpret_cast<__m128i *>(sums.data() + k);
+            auto const high = reinterpret_cast<__m128i *>(sums.data() + k + 8);
+            _mm_storeu_si128(low, _mm_add_epi16(_mm_loadu_si128(low), _mm_unpacklo_epi8(v, zero)));
+            _mm_storeu_si128(high, _mm_add_epi16(_mm_loadu_si128(high), _mm_unpackhi_epi8(v, zero)));
+        }
+#endif
+        for (; k < channels; ++k)
+            sums[k] = static_cast<std::uint16_t>(sums[k] + bytes[k]);
+    }
+
+    // One pixel of sums is 4 channels of 16 bits, 8 bytes
+    auto const count  = f * f;
+    auto       totals = std::vector<std::uint16_t>(std::size_t{preview.width} * 4);
+    auto       x      = 0u;
+#ifdef KALEIDOSCOPE_SSE2
+    auto const pixel = [&](std::uint32_t at)
+    { return _mm_loadl_epi64(reinterpret_cast<__m128i const *>(&sums[std::size_t{at} * 4])); };
+    for (; x + 2 <= preview.width; x += 2)
+    {
+        auto total = _mm_setzero_si128();
+        for (auto i = 0u; i < f; ++i)
+            total = _mm_add_epi16(total, _mm_unpacklo_epi64(pixel(x * f + i), pixel((x + 1) * f + i)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(&totals[std::size_t{x} * 4]), total);
+    }
+#endif
+    for (; x < preview.width; ++x)
+        for (auto i = 0u; i < f; ++i)
+            for (auto c = 0u; c < 4; ++c)
+                totals[std::size_t{x} * 4 + c] += sums[(std::size_t{x} * f + i) * 4 + c];
+
+    // Rounded, by a shift if "count" is a power of 2, else by the reciprocal,
+    // which is exact for up to 256 texels
+    auto const bytes = reinterpret_cast<std::uint8_t *>(line);
+    auto const half  = count / 2;
+    if ((count & (count - 1)) == 0)
+    {
+        auto const shift = static_cast<std::uint32_t>(std::countr_zero(count));
+        for (auto k = std::size_t{}; k < totals.size(); ++k)
+            bytes[k] = static_cast<std::uint8_t>((totals[k] + half) >> shift);
+        return;
+    }
+
+    auto const scale = std::uint64_t{((1u << 24) + count - 1) / count};
+    for (auto k = std::size_t{}; k < totals.size(); ++k)
+        bytes[k] = static_cast<std::uint8_t>(((totals[k] + half) * scale) >> 24);
+}
+
+// The rows of the preview that read only rows "top" to "bottom" of the
+// frame, e.g. a band just rendered.
+auto inline reduce(image::const_view frame, image::view preview, std::uint32_t top, std::uint32_t bottom) -> void
+{
+    if (preview.height == 0 || top >= bottom)
+        return;
+
+    // From the first row that may read "top" on
+    auto y = static_cast<std::uint32_t>(std::uint64_t{top} * preview.height / frame.height);
+    y      = std::min(y, preview.height - 1);
+    while (y > 0 && footprint(frame, preview, y - 1).first >= top)
+        --y;
+    for (; y < preview.height; ++y)
+    {
+        auto const [first, last] = footprint(frame, preview, y);
+        if (last >= bottom)
+            break;
+        if (first >= top)
+            reduce_row(frame, preview, y);
+    }
+}
+
+// Render "target" with "engine" as "parallel::render" does, and reduce every
+// band into "smaller" right after it is rendered, while it is in cache.
+//
+// Bands are whole multiples of the box filter sides where that keeps them
+// short, so that no preview row straddles two of them. Rows that do
+// nonetheless are reduced once all bands are done.
+template <parallel::renderer E>
+auto render(
+    parallel::pool & workers, E const & engine, image::view target, std::span<image::view const> smaller,
+    std::uint32_t rows = 16
+) -> void
+{
+    auto band = parallel::aligned_rows(target, rows);
+    for (auto const & preview : smaller)
+        if (auto const f = factor(target, preview); f > 1 && std::lcm(band, f) <= 4 * band)
+            band = std::lcm(band, f);
+
+    auto const count = (target.height + band - 1) / band;
+    workers.run(
+        count,
+        [&](std::size_t index)
+        {
+            auto const top    = static_cast<std::uint32_t>(index) * band;
+            auto const bottom = std::min(top + band, target.height);
+            engine.on_render(target, {0, top, target.width, bottom});
+            for (auto const & preview : smaller)
+                reduce(target, preview, top, bottom);
+        }
+    );
+
+    // Rows of the previews across two bands
+    auto straddling = std::vector<std::pair<std::size_t, std::uint32_t>>{};
+    for (auto k = std::size_t{}; k < smaller.size(); ++k)
+    {
+        for (auto y = 0u; y < smaller[k].height; ++y)
+        {
+            auto const [first, last] = footprint(target, smaller[k], y);
+            if (first / band != last / band)
+                straddling.emplace_back(k, y);
+        }
+    }
+
+    workers.run(
+        straddling.size(),
+        [&](std::size_t index)
+        {
+            auto const [k, y] = straddling[index];
+            reduce_row(target, smaller[k], y);
+        }
+    );
+}
+} // namespace previews
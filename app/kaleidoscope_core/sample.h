@@ -0,0 +1,158 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+#include "fold.h"
+#include "image.h"
+
+// CPU equivalent of the static sampler in render.cc:
+//
+// - Filter:      D3D12_FILTER_MIN_MAG_MIP_LINEAR (one mip level, so bilinear)
+// - AddressUVW:  D3D12_TEXTURE_ADDRESS_MODE_BORDER
+// - BorderColor: D3D12_STATIC_BORDER_COLOR_TRANSPARENT_BLACK
+//
+// Weights are quantized to 8 bits of subtexel precision, the minimum the D3D11
+// functional spec requires of texture filtering, and all blending is done in
+// integers so that every kernel built on top of it produces identical bytes.
+//
+// The second sampler of render.cc, D3D12_FILTER_MIN_MAG_MIP_POINT, is "point":
+// the texel nearest to the same quantized coordinate, without any blending.
+
+namespace sample
+{
+
+enum class filter
+{
+    linear, // bilinear, four taps
+    point,  // nearest texel, one tap
+};
+
+// Fractional bits of a fixed-point texel coordinate.
+auto inline constexpr subtexel_bits = 8;
+auto inline constexpr subtexel_one  = std::int32_t{1} << subtexel_bits;
+
+// A texture coordinate resolved to the top left tap and its weights.
+struct texel
+{
+    std::int32_t x;
+    std::int32_t y;
+    std::uint8_t fx;
+    std::uint8_t fy;
+};
+
+// Normalized coordinate -> top left tap and weights, in a texture of the given size.
+auto inline resolve(fold::float2 uv, std::uint32_t width, std::uint32_t height) -> texel
+{
+    auto x  = uv.x * static_cast<float>(width) - .5f;
+    auto y  = uv.y * static_cast<float>(height) - .5f;
+    auto qx = static_cast<std::int32_t>(std::floor(x * static_cast<float>(subtexel_one) + .5f));
+    auto qy = static_cast<std::int32_t>(std::floor(y * static_cast<float>(subtexel_one) + .5f));
+    return {
+        qx >> subtexel_bits,
+        qy >> subtexel_bits,
+        static_cast<std::uint8_t>(qx & (subtexel_one - 1)),
+        static_cast<std::uint8_t>(qy & (subtexel_one - 1)),
+    };
+}
+
+// Blend four taps (top left, top right, bottom left, bottom right).
+auto inline blend(image::pixel a, image::pixel b, image::pixel c, image::pixel d, std::uint32_t fx, std::uint32_t fy)
+    -> image::pixel
+{
+    auto const wa = (subtexel_one - fx) * (subtexel_one - fy);
+    auto const wb = fx * (subtexel_one - fy);
+    auto const wc = (subtexel_one - fx) * fy;
+    auto const wd = fx * fy;
+
+    auto out = image::pixel{};
+    for (auto shift = 0; shift < 32; shift += 8)
+    {
+        auto sum = ((a >> shift) & 0xff) * wa + ((b >> shift) & 0xff) * wb + //
+                   ((c >> shift) & 0xff) * wc + ((d >> shift) & 0xff) * wd;
+        out |= ((sum + (1u << (2 * subtexel_bits - 1))) >> (2 * subtexel_bits)) << shift;
+    }
+    return out;
+}
+
+// Texel fetch with border color.
+auto inline fetch(image::const_view source, std::int32_t x, std::int32_t y) -> image::pixel
+{
+    auto const is_outside_x = x < 0 || static_cast<std::uint32_t>(x) >= source.width;
+    auto const is_outside_y = y < 0 || static_cast<std::uint32_t>(y) >= source.height;
+    if (is_outside_x || is_outside_y)
+        return 0;
+
+    return source.at(static_cast<std::uint32_t>(x), static_cast<std::uint32_t>(y));
+}
+
+auto inline linear(image::const_view source, texel const & t) -> image::pixel
+{
+    return blend(
+        fetch(source, t.x, t.y), fetch(source, t.x + 1, t.y), fetch(source, t.x, t.y + 1),
+        fetch(source, t.x + 1, t.y + 1), t.fx, t.fy
+    );
+}
+
+// "screenshot.Sample(screenshot_sampler, uv)"
+auto inline linear(image::const_view source, fold::float2 uv) -> image::pixel
+{
+    return linear(source, resolve(uv, source.width, source.height));
+}
+
+// Top left tap -> the tap of the four with the largest weight.
+auto inline constexpr nearest(texel const & t) -> texel
+{
+    auto constexpr half = subtexel_one / 2;
+    return {t.x + (t.fx >= half ? 1 : 0), t.y + (t.fy >= half ? 1 : 0), 0, 0};
+}
+
+auto inline point(image::const_view source, texel const & t) -> image::pixel
+{
+    auto const n = nearest(t);
+    return fetch(source, n.x, n.y);
+}
+
+// "screenshot.Sample(nearest_sampler, uv)"
+auto inline point(image::const_view source, fold::float2 uv) -> image::pixel
+{
+    return point(source, resolve(uv, source.width, source.height));
+}
+
+// Part of a texture of "width" x "height": "pixels" holds its texels from
+// (left, top) on, e.g. a "staging::patch". Coordinates stay normalized to
+// the whole texture, so sampling inside the part gives the same result.
+struct window
+{
+    image::const_view pixels{};
+    std::int32_t      left{};
+    std::int32_t      top{};
+    std::uint32_t     width{};
+    std::uint32_t     height{};
+};
+
+auto inline whole(image::const_view source) -> window
+{
+    return {source, 0, 0, source.width, source.height};
+}
+
+auto inline linear(window const & source, fold::float2 uv) -> image::pixel
+{
+    auto t = resolve(uv, source.width, source.height);
+    t.x -= source.left;
+    t.y -= source.top;
+    return linear(source.pixels, t);
+}
+
+auto inline point(window const & source, fold::float2 uv) -> image::pixel
+{
+    auto t = resolve(uv, source.width, source.height);
+    t.x -= source.left;
+    t.y -= source.top;
+    return point(source.pixels, t);
+}
+
+auto inline sample(filter how, window const & source, fold::float2 uv) -> image::pixel
+{
+    return how == filter::point ? point(source, uv) : linear(source, uv);
+}
+} // namespace sample
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+
+#include "fold.h"
+#include "image.h"
+#include "kernel.h"
+#include "patch.h"
+#include "sample.h"
+#include "tile_builder.h"
+
+namespace engine
+{
+
+// The fold solved per row, for every row and every pixel of it.
+//
+// Each output row is cut into the segments of "span.h" at the x positions
+// where the fold changes, and "tile_builder" fills them by stepping: runs
+// of translated or flipped copies read one or two source rows contiguously,
+// or are plain row copies if they land on texel centers, and the reflected
+// runs step diagonally through the source. Nothing is stored per pixel, so
+// unlike "fold_map" a frame reads only the output and the source triangle,
+// and unlike "period_tile" it needs no whole-pixel period.
+//
+// No run is a mirrored copy of a source row: "redirect" and the
+// triangulation only flip rows vertically, the reflections are diagonal.
+// With "staging::mode::rotated" the reflected runs read turned copies of the
+// source triangle instead, see "tile_builder".
+class scanline
+{
+public:
+    explicit scanline(sample::filter filter = sample::filter::linear, staging::mode how = staging::mode::crop)
+        : builder(filter, how)
+    {}
+
+    auto on_resize(std::uint32_t width, std::uint32_t height) -> void
+    {
+        output_width  = width;
+        output_height = height;
+        builder.on_resize(width, height);
+    }
+
+    auto on_update(fold::aligned_regular_triangle const & triangle) -> void
+    {
+        current = triangle;
+        builder.on_update(triangle);
+    }
+
+    auto on_capture(image::const_view source) -> void
+    {
+        builder.on_capture(source);
+    }
+
+    auto on_render(image::view target, image::rect const & area) const -> void
+    {
+        auto const output = image::rect{0, 0, output_width, output_height};
+        auto const region = image::intersect(area, image::intersect(target.bounds(), output));
+        if (region.empty())
+            return;
+
+        builder.build(target, region);
+        kernel::cut_out(current, target, region, output_width, output_height);
+    }
+
+    auto on_render(image::view target) const -> void
+    {
+        on_render(target, target.bounds());
+    }
+
+    // Bytes of the runs, for diagnostics.
+    auto footprint() const -> std::size_t
+    {
+        return builder.footprint();
+    }
+
+private:
+    // Inputs
+    fold::aligned_regular_triangle current{};
+    std::uint32_t                  output_width{};
+    std::uint32_t                  output_height{};
+
+    // Derived
+    tile_builder builder;
+};
+} // namespace engine
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+
+#include "fold.h"
+#include "image.h"
+#include "source.h"
+
+namespace schedule
+{
+
+// Decides on every tick whether a frame has to be rendered at all.
+//
+// The output only changes if the window was resized, the triangle changed,
+// or a new source frame changed texels the triangle covers. Everything else
+// keeps the previous output, so an idle desktop costs no rendering.
+class scheduler
+{
+public:
+    // Texels kept around the triangle, for the bilinear taps.
+    auto static constexpr margin = 2.f;
+
+public:
+    auto on_resize(std::uint32_t width, std::uint32_t height) -> void
+    {
+        output_width  = width;
+        output_height = height;
+        is_forced     = true;
+    }
+
+    auto on_update(fold::aligned_regular_triangle const & triangle) -> void
+    {
+        current   = triangle;
+        is_forced = true;
+    }
+
+    // A new source frame arrived.
+    auto on_capture(capture::frame_info const & info) -> void
+    {
+        if (info.width != source_width || info.height != source_height)
+        {
+            source_width  = info.width;
+            source_height = info.height;
+            is_forced     = true;
+            return;
+        }
+
+        auto const area = reach();
+        for (auto const & r : info.dirty)
+            is_pending = is_pending || !image::intersect(r, area).empty();
+    }
+
+    // Whether this tick must render. Counts the answer.
+    auto on_tick() -> bool
+    {
+        auto const yes = is_forced || is_pending;
+        is_forced      = false;
+        is_pending     = false;
+        (yes ? rendered : skipped) += 1;
+        return yes;
+    }
+
+    auto rendered_frames() const -> std::uint64_t
+    {
+        return rendered;
+    }
+
+    auto skipped_frames() const -> std::uint64_t
+    {
+        return skipped;
+    }
+
+private:
+    // Source texels the output reads: the triangle's bounding box.
+    auto reach() const -> image::rect
+    {
+        if (output_width == 0 || output_height == 0)
+            return {};
+
+        auto const sx     = static_cast<float>(source_width) / output_width;
+        auto const sy     = static_cast<float>(source_height) / output_height;
+        auto const height = current.length * fold::half_sqrt3;
+        return image::enclose(
+            (current.top_x - current.length * .5f) * sx - margin, current.top_y * sy - margin,
+            (current.top_x + current.length * .5f) * sx + margin, (current.top_y + height) * sy + margin
+        );
+    }
+
+private:
+    // Inputs
+    fold::aligned_regular_triangle current{};
+    std::uint32_t                  output_width{};
+    std::uint32_t                  output_height{};
+    std::uint32_t                  source_width{};
+    std::uint32_t                  source_height{};
+
+    // States
+    bool          is_forced{true};
+    bool          is_pending{};
+    std::uint64_t rendered{};
+    std::uint64_t skipped{};
+};
+} // namespace schedule
@@ -0,0 +1,215 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "image.h"
+#include "source.h"
+
+namespace capture
+{
+
+// Plays a list of image files, one per "acquire", looping at the end.
+//
+// ".ppm" files are binary PPM (P6) and are converted to BGRA. Any other file
+// is raw BGRA of "raw_width" x "raw_height", rows tightly packed. Dirty info
+// is the bands of rows that differ from the previous frame.
+class sequence final : public image_source
+{
+public:
+    explicit sequence(
+        std::vector<std::filesystem::path> files, std::uint32_t raw_width = 0, std::uint32_t raw_height = 0,
+        bool preload = false
+    )
+        : files(std::move(files))
+        , raw_width(raw_width)
+        , raw_height(raw_height)
+    {
+        if (this->files.empty())
+            throw std::invalid_argument("sequence: no files");
+
+        if (preload)
+        {
+            cache.resize(this->files.size());
+            for (auto index = std::size_t{}; index < cache.size(); ++index)
+                load(this->files[index], cache[index]);
+        }
+    }
+
+    // All regular files of "folder" in name order.
+    auto static from_directory(std::filesystem::path const & folder) -> std::vector<std::filesystem::path>
+    {
+        auto out = std::vector<std::filesystem::path>{};
+        for (auto const & entry : std::filesystem::directory_iterator(folder))
+            if (entry.is_regular_file())
+                out.push_back(entry.path());
+
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+
+    auto acquire(std::chrono::milliseconds /* timeout */ = {}) -> bool override
+    {
+        auto const index  = next++ % files.size();
+        auto const before = shown;
+        if (cache.empty())
+        {
+            // "previous" becomes the frame shown before, if any
+            std::swap(current, previous);
+            load(files[index], current);
+            shown = &current;
+        }
+        else
+        {
+            shown = &cache[index];
+        }
+
+        auto const * last = cache.empty() && before ? &previous : before;
+        status.width      = shown->width();
+        status.height     = shown->height();
+        status.index += 1;
+        if (last == nullptr || last->width() != shown->width() || last->height() != shown->height())
+            whole(status);
+        else
+            compare(*last, *shown);
+
+        return true;
+    }
+
+    auto release() -> void override {}
+
+    auto info() const -> frame_info const & override
+    {
+        return status;
+    }
+
+    auto view() const -> image::const_view override
+    {
+        return shown->const_view();
+    }
+
+private:
+    auto load(std::filesystem::path const & path, image::frame & out) const -> void
+    {
+        auto file = std::ifstream(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("sequence: cannot open " + path.string());
+
+        auto bytes = std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+        if (path.extension() == ".ppm")
+            decode_ppm(path, bytes, out);
+        else
+            decode_raw(path, bytes, out);
+    }
+
+    auto decode_raw(std::filesystem::path const & path, std::vector<char> const & bytes, image::frame & out) const
+        -> void
+    {
+        auto const row = std::size_t{raw_width} * sizeof(image::pixel);
+        if (raw_width == 0 || raw_height == 0 || bytes.size() != row * raw_height)
+            throw std::runtime_error("sequence: " + path.string() + " is not raw BGRA of the given size");
+
+        if (out.width() != raw_width || out.height() != raw_height)
+            out.resize(raw_width, raw_height);
+
+        auto target = out.view();
+        for (auto y = 0u; y < raw_height; ++y)
+            std::memcpy(target.row(y), bytes.data() + y * row, row);
+    }
+
+    auto static decode_ppm(std::filesystem::path const & path, std::vector<char> const & bytes, image::frame & out)
+        -> void
+    {
+        auto const fail = [&] { return std::runtime_error("sequence: " + path.string() + " is not a binary PPM"); };
+
+        // Header: "P6", width, height, maximum, separated by whitespace or comments
+        auto at    = std::size_t{2};
+        auto field = [&]
+        {
+            while (at < bytes.size() && (std::isspace(static_cast<unsigned char>(bytes[at])) || bytes[at] == '#'))
+            {
+                if (bytes[at] == '#')
+                    while (at < bytes.size() && bytes[at] != '\n')
+                        ++at;
+                else
+                    ++at;
+            }
+
+            auto value = std::uint32_t{};
+            auto begin = at;
+            for (; at < bytes.size() && std::isdigit(static_cast<unsigned char>(bytes[at])); ++at)
+                value = value * 10 + static_cast<std::uint32_t>(bytes[at] - '0');
+            if (at == begin || value == 0)
+                throw fail();
+            return value;
+        };
+
+        if (bytes.size() < 2 || bytes[0] != 'P' || bytes[1] != '6')
+            throw fail();
+
+        auto const width   = field();
+        auto const height  = field();
+        auto const maximum = field();
+        at += 1; // single whitespace before the data
+
+        if (maximum > 255 || bytes.size() < at + std::size_t{width} * height * 3)
+            throw fail();
+
+        if (out.width() != width || out.height() != height)
+            out.resize(width, height);
+
+        auto target = out.view();
+        auto from   = reinterpret_cast<unsigned char const *>(bytes.data() + at);
+        auto scale  = [&](unsigned char v) { return static_cast<image::pixel>((v * 255u + maximum / 2) / maximum); };
+        for (auto y = 0u; y < height; ++y)
+        {
+            auto line = target.row(y);
+            for (auto x = 0u; x < width; ++x, from += 3)
+                line[x] = 0xff000000u | scale(from[0]) << 16 | scale(from[1]) << 8 | scale(from[2]);
+        }
+    }
+
+    // Collect bands of rows that changed.
+    auto compare(image::frame const & before, image::frame const & after) -> void
+    {
+        auto const a     = before.const_view();
+        auto const b     = after.const_view();
+        auto const bytes = std::size_t{b.width} * sizeof(image::pixel);
+
+        status.dirty.clear();
+        for (auto y = 0u; y < b.height; ++y)
+        {
+            if (std::memcmp(a.row(y), b.row(y), bytes) == 0)
+                continue;
+
+            if (!status.dirty.empty() && status.dirty.back().bottom == y)
+                status.dirty.back().bottom = y + 1;
+            else
+                status.dirty.push_back({0, y, b.width, y + 1});
+        }
+    }
+
+private:
+    std::vector<std::filesystem::path> files;
+    std::uint32_t                      raw_width;
+    std::uint32_t                      raw_height;
+    std::size_t                        next{};
+
+    // Either decode into "current" every time, or show one of "cache".
+    std::vector<image::frame> cache{};
+    image::frame              current{};
+    image::frame              previous{};
+    image::frame const *      shown{};
+
+    frame_info status{};
+};
+} // namespace capture
@@ -0,0 +1,202 @@
+#pragma once
+#include <cstdint>
+
+#include "cpu.h"
+
+// SSE2 is part of x86-64, so it needs no flag and no runtime check.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KALEIDOSCOPE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace simd
+{
+
+#ifdef KALEIDOSCOPE_SSE2
+
+// [w0, w1, w2, w3] (32-bit) -> [w0 x4, w1 x4] and [w2 x4, w3 x4] (16-bit),
+// one weight per channel of two pixels.
+auto inline spread(__m128i w, __m128i & low, __m128i & high) -> void
+{
+    auto w16 = _mm_packs_epi32(w, w);
+    auto w2  = _mm_unpacklo_epi16(w16, w16);
+    low      = _mm_unpacklo_epi32(w2, w2);
+    high     = _mm_unpackhi_epi32(w2, w2);
+}
+
+// (h0 * (256 - fy) + h1 * fy + 2^15) >> 16 for 8 channels, in 32 bits.
+auto inline vertical(__m128i h0, __m128i h1, __m128i fy) -> __m128i
+{
+    auto const iy   = _mm_sub_epi16(_mm_set1_epi16(256), fy);
+    auto const half = _mm_set1_epi32(1 << 15);
+
+    auto l0 = _mm_mullo_epi16(h0, iy);
+    auto u0 = _mm_mulhi_epu16(h0, iy);
+    auto l1 = _mm_mullo_epi16(h1, fy);
+    auto u1 = _mm_mulhi_epu16(h1, fy);
+
+    auto first  = _mm_add_epi32(_mm_unpacklo_epi16(l0, u0), _mm_unpacklo_epi16(l1, u1));
+    auto second = _mm_add_epi32(_mm_unpackhi_epi16(l0, u0), _mm_unpackhi_epi16(l1, u1));
+    first       = _mm_srli_epi32(_mm_add_epi32(first, half), 16);
+    second      = _mm_srli_epi32(_mm_add_epi32(second, half), 16);
+    return _mm_packs_epi32(first, second);
+}
+
+// Two pixels of 16-bit channels, see "blend4".
+auto inline blend2(__m128i a, __m128i b, __m128i c, __m128i d, __m128i fx, __m128i fy) -> __m128i
+{
+    auto const ix = _mm_sub_epi16(_mm_set1_epi16(256), fx);
+
+    // Both stay below 255 * 256, so 16 bits are enough.
+    auto h0 = _mm_add_epi16(_mm_mullo_epi16(a, ix), _mm_mullo_epi16(b, fx));
+    auto h1 = _mm_add_epi16(_mm_mullo_epi16(c, ix), _mm_mullo_epi16(d, fx));
+    return vertical(h0, h1, fy);
+}
+
+// Bilinear blend of 4 pixels, byte for byte the same as "sample::blend":
+//
+//   a * (256 - fx) * (256 - fy) + b * fx * (256 - fy) + c * (256 - fx) * fy + d * fx * fy
+// = (256 - fy) * (a * (256 - fx) + b * fx) + fy * (c * (256 - fx) + d * fx)
+//
+// The inner sums fit in 16 bits, only the outer one needs 32.
+// "fx" and "fy" hold one weight (0 to 255) per 32-bit lane.
+auto inline blend4(__m128i a, __m128i b, __m128i c, __m128i d, __m128i fx, __m128i fy) -> __m128i
+{
+    auto const zero = _mm_setzero_si128();
+
+    auto fx_low = __m128i{}, fx_high = __m128i{};
+    auto fy_low = __m128i{}, fy_high = __m128i{};
+    spread(fx, fx_low, fx_high);
+    spread(fy, fy_low, fy_high);
+
+    auto low = blend2(
+        _mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero),
+        _mm_unpacklo_epi8(d, zero), fx_low, fy_low
+    );
+    auto high = blend2(
+        _mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero),
+        _mm_unpackhi_epi8(d, zero), fx_high, fy_high
+    );
+    return _mm_packus_epi16(low, high);
+}
+
+#endif
+
+#ifdef KALEIDOSCOPE_X86
+
+// The same steps on 8 and 16 pixels. Every instruction stays within its
+// 128-bit lane, so each lane computes exactly what "blend4" does for its 4
+// pixels.
+
+KALEIDOSCOPE_TARGET_AVX2 auto inline spread(__m256i w, __m256i & low, __m256i & high) -> void
+{
+    auto w16 = _mm256_packs_epi32(w, w);
+    auto w2  = _mm256_unpacklo_epi16(w16, w16);
+    low      = _mm256_unpacklo_epi32(w2, w2);
+    high     = _mm256_unpackhi_epi32(w2, w2);
+}
+
+KALEIDOSCOPE_TARGET_AVX2 auto inline vertical(__m256i h0, __m256i h1, __m256i fy) -> __m256i
+{
+    auto const iy   = _mm256_sub_epi16(_mm256_set1_epi16(256), fy);
+    auto const half = _mm256_set1_epi32(1 << 15);
+
+    auto l0 = _mm256_mullo_epi16(h0, iy);
+    auto u0 = _mm256_mulhi_epu16(h0, iy);
+    auto l1 = _mm256_mullo_epi16(h1, fy);
+    auto u1 = _mm256_mulhi_epu16(h1, fy);
+
+    auto first  = _mm256_add_epi32(_mm256_unpacklo_epi16(l0, u0), _mm256_unpacklo_epi16(l1, u1));
+    auto second = _mm256_add_epi32(_mm256_unpackhi_epi16(l0, u0), _mm256_unpackhi_epi16(l1, u1));
+    first       = _mm256_srli_epi32(_mm256_add_epi32(first, half), 16);
+    second      = _mm256_srli_epi32(_mm256_add_epi32(second, half), 16);
+    return _mm256_packs_epi32(first, second);
+}
+
+KALEIDOSCOPE_TARGET_AVX2 auto inline blend2(__m256i a, __m256i b, __m256i c, __m256i d, __m256i fx, __m256i fy)
+    -> __m256i
+{
+    auto const ix = _mm256_sub_epi16(_mm256_set1_epi16(256), fx);
+    auto       h0 = _mm256_add_epi16(_mm256_mullo_epi16(a, ix), _mm256_mullo_epi16(b, fx));
+    auto       h1 = _mm256_add_epi16(_mm256_mullo_epi16(c, ix), _mm256_mullo_epi16(d, fx));
+    return vertical(h0, h1, fy);
+}
+
+KALEIDOSCOPE_TARGET_AVX2 auto inline blend8(__m256i a, __m256i b, __m256i c, __m256i d, __m256i fx, __m256i fy)
+    -> __m256i
+{
+    auto const zero = _mm256_setzero_si256();
+
+    auto fx_low = __m256i{}, fx_high = __m256i{};
+    auto fy_low = __m256i{}, fy_high = __m256i{};
+    spread(fx, fx_low, fx_high);
+    spread(fy, fy_low, fy_high);
+
+    auto low = blend2(
+        _mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero), _mm256_unpacklo_epi8(c, zero),
+        _mm256_unpacklo_epi8(d, zero), fx_low, fy_low
+    );
+    auto high = blend2(
+        _mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero), _mm256_unpackhi_epi8(c, zero),
+        _mm256_unpackhi_epi8(d, zero), fx_high, fy_high
+    );
+    return _mm256_packus_epi16(low, high);
+}
+
+KALEIDOSCOPE_TARGET_AVX512 auto inline spread(__m512i w, __m512i & low, __m512i & high) -> void
+{
+    auto w16 = _mm512_packs_epi32(w, w);
+    auto w2  = _mm512_unpacklo_epi16(w16, w16);
+    low      = _mm512_unpacklo_epi32(w2, w2);
+    high     = _mm512_unpackhi_epi32(w2, w2);
+}
+
+KALEIDOSCOPE_TARGET_AVX512 auto inline vertical(__m512i h0, __m512i h1, __m512i fy) -> __m512i
+{
+    auto const iy   = _mm512_sub_epi16(_mm512_set1_epi16(256), fy);
+    auto const half = _mm512_set1_epi32(1 << 15);
+
+    auto l0 = _mm512_mullo_epi16(h0, iy);
+    auto u0 = _mm512_mulhi_epu16(h0, iy);
+    auto l1 = _mm512_mullo_epi16(h1, fy);
+    auto u1 = _mm512_mulhi_epu16(h1, fy);
+
+    auto first  = _mm512_add_epi32(_mm512_unpacklo_epi16(l0, u0), _mm512_unpacklo_epi16(l1, u1));
+    auto second = _mm512_add_epi32(_mm512_unpackhi_epi16(l0, u0), _mm512_unpackhi_epi16(l1, u1));
+    first       = _mm512_srli_epi32(_mm512_add_epi32(first, half), 16);
+    second      = _mm512_srli_epi32(_mm512_add_epi32(second, half), 16);
+    return _mm512_packs_epi32(first, second);
+}
+
+KALEIDOSCOPE_TARGET_AVX512 auto inline blend2(__m512i a, __m512i b, __m512i c, __m512i d, __m512i fx, __m512i fy)
+    -> __m512i
+{
+    auto const ix = _mm512_sub_epi16(_mm512_set1_epi16(256), fx);
+    auto       h0 = _mm512_add_epi16(_mm512_mullo_epi16(a, ix), _mm512_mullo_epi16(b, fx));
+    auto       h1 = _mm512_add_epi16(_mm512_mullo_epi16(c, ix), _mm512_mullo_epi16(d, fx));
+    return vertical(h0, h1, fy);
+}
+
+KALEIDOSCOPE_TARGET_AVX512 auto inline blend16(__m512i a, __m512i b, __m512i c, __m512i d, __m512i fx, __m512i fy)
+    -> __m512i
+{
+    auto const zero = _mm512_setzero_si512();
+
+    auto fx_low = __m512i{}, fx_high = __m512i{};
+    auto fy_low = __m512i{}, fy_high = __m512i{};
+    spread(fx, fx_low, fx_high);
+    spread(fy, fy_low, fy_high);
+
+    auto low = blend2(
+        _mm512_unpacklo_epi8(a, zero), _mm512_unpacklo_epi8(b, zero), _mm512_unpacklo_epi8(c, zero),
+        _mm512_unpacklo_epi8(d, zero), fx_low, fy_low
+    );
+    auto high = blend2(
+        _mm512_unpackhi_epi8(a, zero), _mm512_unpackhi_epi8(b, zero), _mm512_unpackhi_epi8(c, zero),
+        _mm512_unpackhi_epi8(d, zero), fx_high, fy_high
+    );
+    return _mm512_packus_epi16(low, high);
+}
+
+#endif
+} // namespace simd
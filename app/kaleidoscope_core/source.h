@@ -0,0 +1,67 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "image.h"
+
+namespace capture
+{
+
+// Layout of the pixels a source hands out.
+enum class pixel_format : std::uint8_t
+{
+    bgra8, // DXGI_FORMAT_B8G8R8A8_UNORM, see "image::pixel"
+};
+
+// Describes the frame held by a source after a successful "acquire".
+struct frame_info
+{
+    std::uint32_t width{};
+    std::uint32_t height{};
+    pixel_format  format{pixel_format::bgra8};
+
+    // Areas changed since the previous frame. A source that can't tell
+    // reports the whole frame.
+    std::vector<image::rect> dirty{};
+
+    // Frames acquired so far, counting this one.
+    std::uint64_t index{};
+};
+
+// Anything that produces frames for the mirror: the desktop duplication on
+// Windows, files or generated images elsewhere.
+//
+// The protocol follows IDXGIOutputDuplication: "release" the previous frame
+// right before the next "acquire". A frame stays valid until it is released.
+class frame_source
+{
+public:
+    virtual ~frame_source() = default;
+
+    // Wait up to "timeout" for a new frame. Return false if nothing changed;
+    // then there is no frame to use and nothing to release.
+    virtual auto acquire(std::chrono::milliseconds timeout = {}) -> bool = 0;
+
+    // Give back the frame of the last successful "acquire". Does nothing if
+    // there is none.
+    virtual auto release() -> void = 0;
+
+    // The frame of the last successful "acquire".
+    virtual auto info() const -> frame_info const & = 0;
+};
+
+// A source whose frames live in system memory.
+class image_source : public frame_source
+{
+public:
+    // Pixels of the current frame, valid until "release".
+    virtual auto view() const -> image::const_view = 0;
+};
+
+// Shorthand for sources that report the whole frame as changed.
+auto inline whole(frame_info & info) -> void
+{
+    info.dirty.assign(1, image::rect{0, 0, info.width, info.height});
+}
+} // namespace capture
@@ -0,0 +1,164 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "fold.h"
+
+// The fold of "pixel_shader.hlsl", solved per output row.
+//
+// In pixel space "redirect" only translates and flips rows, and both
+// "reflect" calls are orthogonal reflections across the triangle's left and
+// right edges. So along one output row the source point moves in straight
+// segments, each in one of three directions:
+//
+//   forward (1, 0):             translated or flipped copies of the triangle
+//   left    (-1/2, -sqrt3 / 2): reflected across the left edge
+//   right   (-1/2, +sqrt3 / 2): reflected across the right edge
+//
+// The segments of a row only break at a few x positions, which are solved
+// here analytically, once per segment instead of once per pixel.
+
+namespace span
+{
+
+enum class direction : std::uint8_t
+{
+    forward,
+    left,
+    right,
+};
+
+// A run of output pixels [begin, end) of one row. "x" and "y" is the source
+// point of the center of pixel "begin", in output pixels.
+struct segment
+{
+    std::uint32_t begin;
+    std::uint32_t end;
+    direction     heading;
+    double        x;
+    double        y;
+};
+
+auto inline constexpr sqrt3 = 1.7320508075688772935274463415059;
+
+// Unit step of the source point per output pixel.
+auto inline step(direction heading) -> std::pair<double, double>
+{
+    switch (heading)
+    {
+    case direction::left:
+        return {-.5, -sqrt3 * .5};
+    case direction::right:
+        return {-.5, +sqrt3 * .5};
+    default:
+        return {1., 0.};
+    }
+}
+
+// Triangle in output pixels.
+class geometry
+{
+public:
+    geometry() = default;
+
+    explicit geometry(fold::aligned_regular_triangle const & t)
+        : top_y(t.top_y)
+        , origin(t.top_x - t.length * .5)
+        , length(t.length)
+        , height(t.length * sqrt3 * .5)
+    {}
+
+    // Split [left, right) of row y into segments, appending them to "out".
+    auto plan(std::uint32_t y, std::uint32_t left, std::uint32_t right, std::vector<segment> & out) const -> void
+    {
+        if (length <= 0. || left >= right)
+            return;
+
+        // Row inside the vertical period, relative to "top_y - height"
+        auto const period_x = length * 3.;
+        auto const period_y = height * 2.;
+        auto const row      = wrap(y + .5 - (top_y - height), period_y);
+
+        // Relative row in each half of the horizontal period, see "redirect"
+        auto const lower = row >= height;
+        auto const r_of  = std::array<double, 2>{lower ? row - height : height - row, lower ? 2. * height - row : row};
+
+        for (auto x = left; x < right;)
+        {
+            auto const u    = wrap(x + .5 - origin, period_x);
+            auto const half = u >= length * 1.5 ? 1 : 0;
+            auto const s    = u - half * length * 1.5;
+            auto const r    = r_of[half];
+
+            // Break points of "Triangulation" and "Reflect"
+            auto const bl = length * (height - r) / (2. * height);
+            auto const br = length - bl;
+            auto const b2 = length + bl;
+
+            auto heading = direction::forward;
+            auto point   = std::pair{s, r};
+            auto until   = br;
+            if (s < bl)
+            {
+                heading = direction::left;
+                point   = reflect_left(s, r);
+                until   = bl;
+            }
+            else if (s > b2)
+            {
+                heading = direction::left;
+                point   = reflect_left(s - length * 1.5, height - r);
+                until   = length * 1.5;
+            }
+            else if (s > br)
+            {
+                heading = direction::right;
+                point   = reflect_right(s, r);
+                until   = b2;
+            }
+
+            // Pixels whose center is still before "until", at least one.
+            auto count = std::max(std::ceil(until - s), 1.);
+            auto end   = static_cast<std::uint32_t>(std::min(static_cast<double>(right), x + count));
+            out.push_back(segment{x, end, heading, point.first + origin, point.second + top_y});
+            x = end;
+        }
+    }
+
+    auto side() const -> double
+    {
+        return length;
+    }
+
+private:
+    auto static wrap(double v, double period) -> double
+    {
+        auto w = v - std::floor(v / period) * period;
+        return w >= period ? 0. : w;
+    }
+
+    // Across the edge from (0, height) to (length / 2, 0), in band coordinates.
+    auto reflect_left(double s, double r) const -> std::pair<double, double>
+    {
+        auto t = s * .5 - (r - height) * sqrt3 * .5;
+        return {t - s, 2. * height - sqrt3 * t - r};
+    }
+
+    // Across the edge from (length, height) to (length / 2, 0).
+    auto reflect_right(double s, double r) const -> std::pair<double, double>
+    {
+        auto t = (s - length) * .5 + (r - height) * sqrt3 * .5;
+        return {2. * length + t - s, 2. * height + sqrt3 * t - r};
+    }
+
+private:
+    double top_y{};
+    double origin{}; // left corner of the triangle
+    double length{};
+    double height{};
+};
+} // namespace span
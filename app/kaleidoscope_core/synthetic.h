@@ -0,0 +1,143 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "image.h"
+#include "source.h"
+
+namespace capture
+{
+
+// Generates frames: a fixed backdrop of gradients and checkers, plus a box
+// that bounces around and changes color every frame. Only the old and the
+// new place of the box are reported dirty, like a mostly idle desktop.
+//
+// A new frame is ready every "interval", or on every "acquire" if zero, so
+// the pipeline can be driven at any frame rate without a display.
+class synthetic final : public image_source
+{
+public:
+    synthetic(
+        std::uint32_t width, std::uint32_t height, std::chrono::microseconds interval = {}, std::uint32_t box = 64
+    )
+        : pixels(width, height)
+        , interval(interval)
+        , size(std::max(1u, std::min({box, width, height})))
+    {
+        status.width  = width;
+        status.height = height;
+
+        auto target = pixels.view();
+        for (auto y = 0u; y < height; ++y)
+            for (auto x = 0u; x < width; ++x)
+                target.at(x, y) = backdrop(x, y);
+    }
+
+    auto acquire(std::chrono::milliseconds timeout = {}) -> bool override
+    {
+        if (interval.count() != 0 && status.index != 0)
+        {
+            auto const now = clock::now();
+            if (now < due)
+            {
+                if (now + timeout < due)
+                {
+                    std::this_thread::sleep_for(timeout);
+                    return false;
+                }
+                std::this_thread::sleep_until(due);
+            }
+
+            // Don't try to catch up after a stall
+            due = std::max(due, now) + interval;
+        }
+        else
+        {
+            due = clock::now() + interval;
+        }
+
+        status.index += 1;
+        if (status.index == 1)
+        {
+            whole(status);
+            paint(place());
+            return true;
+        }
+
+        auto const before = place();
+        ++step;
+        auto const after = place();
+
+        erase(before);
+        paint(after);
+        status.dirty.assign({before, after});
+        return true;
+    }
+
+    auto release() -> void override {}
+
+    auto info() const -> frame_info const & override
+    {
+        return status;
+    }
+
+    auto view() const -> image::const_view override
+    {
+        return pixels.const_view();
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    auto static backdrop(std::uint32_t x, std::uint32_t y) -> image::pixel
+    {
+        auto r = (x / 4) & 0xffu;
+        auto g = (y / 4) & 0xffu;
+        auto b = ((x / 32 + y / 32) & 1) ? 0xe0u : 0x20u;
+        return 0xff000000u | r << 16 | g << 8 | b;
+    }
+
+    // Bounce between the edges, 7 pixels right and 5 down per frame.
+    auto place() const -> image::rect
+    {
+        auto const bounce = [](std::uint64_t travel, std::uint32_t room) -> std::uint32_t
+        {
+            if (room == 0)
+                return 0;
+
+            auto t = travel % (2 * std::uint64_t{room});
+            return static_cast<std::uint32_t>(t < room ? t : 2 * room - t);
+        };
+
+        auto x = bounce(step * 7, status.width - size);
+        auto y = bounce(step * 5, status.height - size);
+        return {x, y, x + size, y + size};
+    }
+
+    auto erase(image::rect const & area) -> void
+    {
+        auto target = pixels.view();
+        for (auto y = area.top; y < area.bottom; ++y)
+            for (auto x = area.left; x < area.right; ++x)
+                target.at(x, y) = backdrop(x, y);
+    }
+
+    auto paint(image::rect const & area) -> void
+    {
+        auto const color = 0xff000000u | static_cast<image::pixel>(step * 0x010305u & 0xffffffu);
+        auto       rows  = pixels.view().sub(area);
+        for (auto y = 0u; y < rows.height; ++y)
+            std::fill_n(rows.row(y), rows.width, color);
+    }
+
+private:
+    image::frame              pixels;
+    std::chrono::microseconds interval;
+    std::uint32_t             size;
+    std::uint64_t             step{};
+    clock::time_point         due{};
+    frame_info                status{};
+};
+} // namespace capture
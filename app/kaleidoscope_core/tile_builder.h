@@ -0,0 +1,567 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "fold.h"
+#include "image.h"
+#include "kernel.h"
+#include "patch.h"
+#include "sample.h"
+#include "span.h"
+
+namespace engine
+{
+
+// Build output rows from the source triangle by block reflections.
+//
+// The triangle is extracted once per frame into a patch. Every other pixel
+// is one of its translated, flipped or reflected copies, so each row is cut
+// into segments (see "span.h") and every segment is filled by a dedicated
+// kernel: "kernel::forward" for translated and flipped copies, which read
+// source rows contiguously, and "kernel::stepped" for the +-60 degree
+// reflections. No pixel runs the branches or divisions of "reflect".
+//
+// The segments only depend on the triangle and the sizes, so they are
+// resolved into "run"s once, not per frame. If the horizontal period is a
+// whole number of pixels, only one period of each row is kept and repeated.
+//
+// Runs are in patch texels, and the patch moves with the triangle. A move
+// by whole texels, which is what a drag does, therefore keeps every run:
+// only the rows and columns they are applied to shift, and rows that come
+// into view are planned. Only a new length, size or scale plans them all.
+//
+// Rows are processed in blocks of "block_rows" x "block_columns" pixels, so
+// the diagonal reads of neighbouring rows hit the same cached source lines.
+//
+// With "sample::filter::point" the kernels become "kernel::forward_point",
+// a row copy, and "kernel::stepped_point", one load per pixel.
+//
+// With "staging::mode::rotated" each frame is also resampled into two turned
+// copies of the patch, one per reflected direction, whose rows run along
+// that direction. The reflected runs then read those with "kernel::forward",
+// so every run reads rows contiguously, for one more bilinear resampling.
+// The copies only cover the triangle, so each is about the patch's size, or
+// the triangle's size in output pixels if the output is larger than the
+// source.
+class tile_builder
+{
+public:
+    auto static constexpr block_rows    = 8u;
+    auto static constexpr block_columns = 64u;
+
+public:
+    explicit tile_builder(sample::filter filter = sample::filter::linear, staging::mode how = staging::mode::crop)
+        : filter(filter)
+        , how(how)
+    {}
+
+    auto on_resize(std::uint32_t width, std::uint32_t height) -> void
+    {
+        output_width  = width;
+        output_height = height;
+        is_stale      = true;
+    }
+
+    auto on_update(fold::aligned_regular_triangle const & triangle) -> void
+    {
+        if (triangle.length != current.length)
+            is_stale = true;
+
+        current = triangle;
+        shape   = span::geometry(triangle);
+    }
+
+    auto on_capture(image::const_view source) -> void
+    {
+        if (source.width != source_width || source.height != source_height)
+        {
+            source_width  = source.width;
+            source_height = source.height;
+            is_stale      = true;
+        }
+
+        if (is_stale && output_width != 0 && output_height != 0)
+        {
+            scale_x = static_cast<double>(source_width) / output_width;
+            scale_y = static_cast<double>(source_height) / output_height;
+            triangle.on_update(current, scale_x, scale_y);
+            rebuild();
+            is_stale = false;
+        }
+        else if (!is_stale && (current.top_x - anchor.top_x != shift_x || current.top_y - anchor.top_y != shift_y))
+        {
+            triangle.on_update(current, scale_x, scale_y);
+            if (!follow())
+                rebuild();
+        }
+
+        triangle.on_capture(source);
+        if (is_turned())
+            turn();
+    }
+
+    // Fill "area" of "target". The inside of the triangle is not cut out.
+    auto build(image::view target, image::rect const & area) const -> void
+    {
+        auto const output = image::rect{0, 0, output_width, output_height};
+        auto const region = image::intersect(area, image::intersect(target.bounds(), output));
+        if (region.empty() || runs.empty())
+            return;
+
+        auto cursor = std::array<position, block_rows>{};
+        for (auto top = region.top; top < region.bottom; top += block_rows)
+        {
+            auto const rows = std::min(block_rows, region.bottom - top);
+            for (auto k = 0u; k < rows; ++k)
+                cursor[k] = seek(top + k, region.left);
+
+            for (auto left = region.left; left < region.right; left += block_columns)
+            {
+                auto const right = std::min(left + block_columns, region.right);
+                for (auto k = 0u; k < rows; ++k)
+                    advance(cursor[k], left, right, target.row(top + k));
+            }
+        }
+    }
+
+    // Bytes of the runs, for diagnostics.
+    auto footprint() const -> std::size_t
+    {
+        auto turned_bytes = std::size_t{};
+        for (auto const & t : turns)
+            turned_bytes += t.pixels.stride() * t.pixels.height() * sizeof(image::pixel);
+        return runs.size() * sizeof(run) + first.size() * sizeof(first[0]) + turned_bytes;
+    }
+
+private:
+    // How a run is filled.
+    enum class kind : std::uint8_t
+    {
+        forward, // one texel right per pixel
+        stepped,
+        edge, // taps may leave the patch by rounding, sampled one by one
+    };
+
+    // A segment of "span.h", resolved into patch texels.
+    struct run
+    {
+        std::uint32_t   begin;
+        std::uint32_t   end;
+        std::int64_t    x; // source point of pixel "begin", in 32.32 patch texels
+        std::int64_t    y;
+        span::direction heading;
+        kind            how;
+    };
+
+    // 32.32 fixed point, precise enough that stepping along a whole row
+    // stays within a fraction of "kernel::fraction_bits".
+    auto static constexpr precise_bits = 32;
+
+    auto static precise(double v) -> std::int64_t
+    {
+        return static_cast<std::int64_t>(std::floor(std::ldexp(v, precise_bits) + .5));
+    }
+
+    // 32.32 -> 16.16, rounded
+    auto static coarse(std::int64_t v) -> std::int32_t
+    {
+        auto constexpr shift = precise_bits - kernel::fraction_bits;
+        return static_cast<std::int32_t>((v + (std::int64_t{1} << (shift - 1))) >> shift);
+    }
+
+    // The patch resampled for the runs of one reflected direction: texel
+    // (u, v) is patch point "origin + u * along + v * across", so such a run
+    // moves one texel right per pixel here. Texels whose taps would leave the
+    // patch are black.
+    struct turned
+    {
+        image::frame          pixels{};
+        std::array<double, 2> origin{};
+        std::array<double, 2> along{};  // patch texels per output pixel of the run
+        std::array<double, 2> across{}; // at a right angle to "along", one texel or as long as "along" if shorter
+
+        // (u, v) of patch point (x, y).
+        auto locate(double x, double y) const -> std::array<double, 2>
+        {
+            auto const dx  = x - origin[0];
+            auto const dy  = y - origin[1];
+            auto const det = along[0] * across[1] - along[1] * across[0];
+            return {(dx * across[1] - dy * across[0]) / det, (along[0] * dy - along[1] * dx) / det};
+        }
+    };
+
+    // Where a row is being filled: its runs, the next one, and the output x
+    // that copy of the runs starts at.
+    struct position
+    {
+        std::uint32_t row;
+        std::uint32_t index;
+        std::int32_t  base;
+    };
+
+    // Plan every row again, for the triangle where it is now.
+    auto rebuild() -> void
+    {
+        // Whole-pixel periods are kept once, anything else for the full width.
+        auto const period = 3. * shape.side();
+        is_periodic       = period >= 1. && std::floor(period) == period;
+        cover             = is_periodic ? static_cast<std::uint32_t>(period) : output_width;
+
+        for (auto heading : {span::direction::forward, span::direction::left, span::direction::right})
+        {
+            auto const [ux, uy] = span::step(heading);
+            auto const h        = static_cast<std::size_t>(heading);
+            steps[h]            = {precise(ux * scale_x), precise(uy * scale_y)};
+        }
+
+        anchor    = current;
+        shift_x   = 0;
+        shift_y   = 0;
+        row_begin = 0;
+        runs.clear();
+        first.assign(1, 0);
+        plan(0, output_height, runs, first);
+        if (is_turned())
+            orient();
+    }
+
+    // Not for an output smaller than the source: a copy with a texel per
+    // output pixel would skip texels of the patch, and reading the patch
+    // directly is cheap at that size anyway.
+    auto is_turned() const -> bool
+    {
+        return how == staging::mode::rotated && filter == sample::filter::linear && scale_x <= 1. && scale_y <= 1.;
+    }
+
+    // Place the turned copies around the triangle, in patch texels, which
+    // stay the same while the patch moves with the triangle.
+    auto orient() -> void
+    {
+        auto const height = static_cast<double>(current.length) * fold::half_sqrt3;
+        auto const corner = [&](double x, double y)
+        { return std::array<double, 2>{x * scale_x - .5 - triangle.left(), y * scale_y - .5 - triangle.top()}; };
+        auto const corners = std::array{
+            corner(current.top_x, current.top_y),
+            corner(current.top_x - current.length * .5, current.top_y + height),
+            corner(current.top_x + current.length * .5, current.top_y + height),
+        };
+
+        for (auto heading : {span::direction::left, span::direction::right})
+        {
+            auto &     t        = turns[static_cast<std::size_t>(heading) - 1];
+            auto const [ux, uy] = span::step(heading);
+            auto const along    = std::array<double, 2>{ux * scale_x, uy * scale_y};
+            auto const norm     = std::hypot(along[0], along[1]);
+            auto const spacing  = std::min(1., norm) / norm;
+            t.along             = along;
+            t.across            = {-along[1] * spacing, along[0] * spacing};
+            t.origin            = {};
+
+            auto low  = t.locate(corners[0][0], corners[0][1]);
+            auto high = low;
+            for (auto const & c : corners)
+            {
+                auto const [u, v] = t.locate(c[0], c[1]);
+                low               = {std::min(low[0], u), std::min(low[1], v)};
+                high              = {std::max(high[0], u), std::max(high[1], v)};
+            }
+
+            // Same margin as the patch, for the taps
+            auto constexpr margin = staging::region::margin;
+            auto const u0         = std::floor(low[0]) - margin;
+            auto const v0         = std::floor(low[1]) - margin;
+            t.origin = {u0 * t.along[0] + v0 * t.across[0], u0 * t.along[1] + v0 * t.across[1]};
+            t.pixels.resize(
+                static_cast<std::uint32_t>(std::ceil(high[0]) - u0) + margin + 1,
+                static_cast<std::uint32_t>(std::ceil(high[1]) - v0) + margin + 1
+            );
+        }
+    }
+
+    // Resample the patch of this frame into the turned copies.
+    auto turn() -> void
+    {
+        auto const source = triangle.view();
+        auto const width  = source.width - 1.;
+        auto const height = source.height - 1.;
+        for (auto & t : turns)
+        {
+            auto const view = t.pixels.view();
+            auto const dx   = coarse(precise(t.along[0]));
+            auto const dy   = coarse(precise(t.along[1]));
+            for (auto v = 0u; v < view.height; ++v)
+            {
+                auto const x = t.origin[0] + v * t.across[0];
+                auto const y = t.origin[1] + v * t.across[1];
+
+                // Texels u whose point stays in [0, width) x [0, height), one
+                // less at each end for rounding
+                auto low  = 0.;
+                auto high = static_cast<double>(view.width);
+                auto const clip = [&](double p, double d, double size)
+                {
+                    if (d != 0.)
+                    {
+                        auto const a = (0. - p) / d;
+                        auto const b = (size - p) / d;
+                        low          = std::max(low, std::min(a, b));
+                        high         = std::min(high, std::max(a, b));
+                    }
+                    else if (p < 0. || p >= size)
+                    {
+                        high = low;
+                    }
+                };
+                clip(x, t.along[0], width);
+                clip(y, t.along[1], height);
+
+                auto const line  = view.row(v);
+                auto const begin = static_cast<std::uint32_t>(std::clamp(std::ceil(low) + 1., 0., high));
+                auto const last  = std::max(std::floor(high) - 1., static_cast<double>(begin));
+                auto const end   = static_cast<std::uint32_t>(last);
+                if (end > begin)
+                {
+                    auto const sx = coarse(precise(x + begin * t.along[0]));
+                    auto const sy = coarse(precise(y + begin * t.along[1]));
+                    kernel::stepped(source, sx, sy, dx, dy, line + begin, end - begin);
+                }
+
+                // Near the ends some taps leave the patch, further out all
+                auto constexpr reach = 3u;
+                auto const     edge  = [&](std::uint32_t u)
+                {
+                    auto uv = fold::float2{
+                        static_cast<float>((x + u * t.along[0] + .5) / source.width),
+                        static_cast<float>((y + u * t.along[1] + .5) / source.height),
+                    };
+                    line[u] = sample::sample(filter, sample::whole(source), uv);
+                };
+                auto const head = begin < reach ? 0u : begin - reach;
+                auto const tail = std::min(end + reach, view.width);
+                std::memset(line, 0, head * sizeof(image::pixel));
+                for (auto u = head; u < begin; ++u)
+                    edge(u);
+                for (auto u = std::max(begin, end); u < tail; ++u)
+                    edge(u);
+                std::memset(line + tail, 0, (view.width - tail) * sizeof(image::pixel));
+            }
+        }
+    }
+
+    // Keep the runs after a move of the triangle, if it moved by whole
+    // texels, and plan the rows that came into view. The patch must already
+    // be at the new position.
+    auto follow() -> bool
+    {
+        auto const dx    = static_cast<double>(current.top_x) - anchor.top_x;
+        auto const dy    = static_cast<double>(current.top_y) - anchor.top_y;
+        auto const whole = [](double v) { return std::floor(v) == v; };
+        if (!whole(dx) || !whole(dy) || !whole(dx * scale_x) || !whole(dy * scale_y) || (dx != 0. && !is_periodic))
+            return false;
+
+        // Rows of the anchor the output needs, and those kept so far
+        auto const from  = -dy;
+        auto const until = from + output_height;
+        auto const kept  = static_cast<double>(row_begin);
+        auto const end   = kept + static_cast<double>(first.size() - 1);
+        if (from > end || until < kept || std::max(until, end) - std::min(from, kept) > 2. * output_height)
+            return false;
+
+        shift_x = static_cast<std::int32_t>(dx);
+        shift_y = static_cast<std::int32_t>(dy);
+
+        if (from < kept)
+        {
+            auto head  = std::vector<run>{};
+            auto index = std::vector<std::uint32_t>{0};
+            plan(0, static_cast<std::uint32_t>(kept - from), head, index);
+
+            auto const count = static_cast<std::uint32_t>(head.size());
+            for (auto i = std::size_t{1}; i < first.size(); ++i)
+                index.push_back(first[i] + count);
+            head.insert(head.end(), runs.begin(), runs.end());
+
+            runs      = std::move(head);
+            first     = std::move(index);
+            row_begin = static_cast<std::int32_t>(from);
+        }
+
+        if (until > end)
+            plan(static_cast<std::uint32_t>(end + dy), output_height, runs, first);
+
+        return true;
+    }
+
+    // Append the runs of output rows [from, until), for the triangle where
+    // it is now but in columns of the anchor, and where each row ends.
+    auto plan(std::uint32_t from, std::uint32_t until, std::vector<run> & out, std::vector<std::uint32_t> & ends) const
+        -> void
+    {
+        // The first output x in column 0 of the anchor's runs
+        auto const phase = (cover - column(0)) % cover;
+
+        auto pieces = std::vector<span::segment>{};
+        for (auto y = from; y < until; ++y)
+        {
+            pieces.clear();
+            shape.plan(y, phase, phase + cover, pieces);
+            for (auto const & piece : pieces)
+            {
+                auto r = resolve(piece);
+                r.begin -= phase;
+                r.end -= phase;
+                out.push_back(r);
+            }
+            ends.push_back(static_cast<std::uint32_t>(out.size()));
+        }
+    }
+
+    auto resolve(span::segment const & piece) const -> run
+    {
+        auto const source   = triangle.view();
+        auto const [ux, uy] = span::step(piece.heading);
+
+        auto const x    = piece.x * scale_x - .5 - triangle.left();
+        auto const y    = piece.y * scale_y - .5 - triangle.top();
+        auto const last = static_cast<double>(piece.end - 1 - piece.begin);
+        auto const fits = [&](double px, double py)
+        {
+            // Both taps of the rounded position must be inside the patch.
+            auto qx = std::floor(px * sample::subtexel_one + .5) / sample::subtexel_one;
+            auto qy = std::floor(py * sample::subtexel_one + .5) / sample::subtexel_one;
+            return qx >= 0. && qy >= 0. && qx < source.width - 1. && qy < source.height - 1.;
+        };
+
+        auto how = kind::stepped;
+        if (!fits(x, y) || !fits(x + ux * scale_x * last, y + uy * scale_y * last))
+            how = kind::edge;
+        else if (piece.heading == span::direction::forward && scale_x == 1.)
+            how = kind::forward;
+
+        return {piece.begin, piece.end, precise(x), precise(y), piece.heading, how};
+    }
+
+    // Column of the anchor's runs that output x falls into.
+    auto column(std::int32_t x) const -> std::uint32_t
+    {
+        auto const width = static_cast<std::int32_t>(cover);
+        return static_cast<std::uint32_t>(((x - shift_x) % width + width) % width);
+    }
+
+    // The run of output row "y" that covers output pixel "x".
+    auto seek(std::uint32_t y, std::uint32_t x) const -> position
+    {
+        auto const row   = static_cast<std::uint32_t>(static_cast<std::int32_t>(y) - shift_y - row_begin);
+        auto const phase = column(static_cast<std::int32_t>(x));
+        auto const begin = runs.begin() + first[row];
+        auto const end   = runs.begin() + first[row + 1];
+        auto const at    = std::upper_bound(
+            begin, end, phase, [](std::uint32_t v, run const & r) { return v < r.end; }
+        );
+        return {row, static_cast<std::uint32_t>(at - runs.begin()), static_cast<std::int32_t>(x - phase)};
+    }
+
+    // Fill output pixels [left, right) of a row, from the run at the cursor.
+    auto advance(position & at, std::uint32_t left, std::uint32_t right, image::pixel * line) const -> void
+    {
+        auto const begin = first[at.row];
+        auto const end   = first[at.row + 1];
+        if (begin == end)
+            return;
+
+        for (auto x = left; x < right;)
+        {
+            auto const & piece = runs[at.index];
+            auto const   stop  = static_cast<std::int64_t>(at.base) + piece.end;
+            auto const   until = static_cast<std::uint32_t>(std::min<std::int64_t>(stop, right));
+            auto const   skip  = static_cast<std::uint32_t>(static_cast<std::int64_t>(x) - at.base);
+            fill(piece, skip, skip + (until - x), line + x);
+            x = until;
+
+            if (until == stop && ++at.index == end)
+            {
+                at.index = begin;
+                at.base += static_cast<std::int32_t>(cover);
+            }
+        }
+    }
+
+    // Fill pixels [begin, end) of one run into "out", which is pixel "begin".
+    auto fill(run const & piece, std::uint32_t begin, std::uint32_t end, image::pixel * out) const -> void
+    {
+        auto const source = triangle.view();
+        auto const step   = steps[static_cast<std::size_t>(piece.heading)];
+        auto const offset = static_cast<std::int64_t>(begin - piece.begin);
+        auto const x      = piece.x + step[0] * offset;
+        auto const y      = piece.y + step[1] * offset;
+        auto const dx     = coarse(step[0]);
+        auto const dy     = coarse(step[1]);
+        auto const count  = end - begin;
+
+        if (piece.how == kind::edge)
+        {
+            for (auto i = 0; i < static_cast<int>(count); ++i)
+            {
+                auto uv = fold::float2{
+                    static_cast<float>((std::ldexp(x + step[0] * i, -precise_bits) + .5) / source.width),
+                    static_cast<float>((std::ldexp(y + step[1] * i, -precise_bits) + .5) / source.height),
+                };
+                out[i] = sample::sample(filter, sample::whole(source), uv);
+            }
+        }
+        else if (filter == sample::filter::point)
+        {
+            if (piece.how == kind::forward)
+                kernel::forward_point(source, coarse(x), coarse(y), out, count);
+            else
+                kernel::stepped_point(source, coarse(x), coarse(y), dx, dy, out, count);
+        }
+        else if (piece.how == kind::forward)
+        {
+            kernel::forward(source, coarse(x), coarse(y), out, count);
+        }
+        else if (is_turned() && piece.heading != span::direction::forward)
+        {
+            auto const & t      = turns[static_cast<std::size_t>(piece.heading) - 1];
+            auto const [tu, tv] = t.locate(std::ldexp(x, -precise_bits), std::ldexp(y, -precise_bits));
+            kernel::forward(t.pixels.const_view(), coarse(precise(tu)), coarse(precise(tv)), out, count);
+        }
+        else
+        {
+            kernel::stepped(source, coarse(x), coarse(y), dx, dy, out, count);
+        }
+    }
+
+private:
+    // Inputs
+    sample::filter                 filter;
+    staging::mode                  how;
+    fold::aligned_regular_triangle current{};
+    std::uint32_t                  output_width{};
+    std::uint32_t                  output_height{};
+    std::uint32_t                  source_width{};
+    std::uint32_t                  source_height{};
+
+    // Derived
+    fold::aligned_regular_triangle             anchor{}; // where the runs were planned
+    std::int32_t                               shift_x{}; // move of the triangle since, in output pixels
+    std::int32_t                               shift_y{};
+    span::geometry                             shape{};
+    staging::patch                             triangle{};
+    double                                     scale_x{1.};
+    double                                     scale_y{1.};
+    std::uint32_t                              cover{}; // output pixels of each row the runs cover
+    std::array<std::array<std::int64_t, 2>, 3> steps{}; // per "span::direction", 32.32
+    std::vector<run>                           runs{};
+    std::vector<std::uint32_t>                 first{}; // runs of anchor row row_begin + i: [first[i], first[i + 1])
+    std::int32_t                               row_begin{};
+    std::array<turned, 2>                      turns{}; // for "left" and "right", with "staging::mode::rotated"
+    bool                                       is_periodic{};
+    bool                                       is_stale{true};
+};
+} // namespace engine
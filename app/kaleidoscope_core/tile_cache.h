@@ -0,0 +1,410 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "sample.h"
+
+namespace tiles
+{
+
+// What a tile is for. Only a bounded set of integer side lengths ever
+// occurs on one monitor, see "model::scoped_triangle::zoom_to".
+struct key
+{
+    std::uint32_t  width{}; // of the output
+    std::uint32_t  height{};
+    std::uint32_t  length{};
+    sample::filter filter{};
+    std::uint32_t  version{}; // of the tile's layout, bumped by its owner
+
+    auto operator==(key const &) const -> bool = default;
+};
+
+// The bytes of one tile, read-only: a mapped file, or a copy in memory if
+// it couldn't be written.
+class blob
+{
+public:
+    blob(blob const &)                     = delete;
+    auto operator=(blob const &) -> blob & = delete;
+
+    ~blob()
+    {
+#ifdef _WIN32
+        if (view != nullptr)
+            UnmapViewOfFile(view);
+#else
+        if (view != nullptr)
+            munmap(view, length);
+#endif
+    }
+
+    // The whole file, nothing if it can't be mapped.
+    auto static map(std::filesystem::path const & path) -> std::unique_ptr<blob>
+    {
+        auto out = std::unique_ptr<blob>{new blob{}};
+#ifdef _WIN32
+        auto file = CreateFileW(
+            path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, nullptr
+        );
+        if (file == INVALID_HANDLE_VALUE)
+            return nullptr;
+
+        auto size    = LARGE_INTEGER{};
+        auto kept    = GetFileSizeEx(file, &size) && size.QuadPart > 0;
+        auto mapping = kept ? CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+        CloseHandle(file);
+        if (mapping == nullptr)
+            return nullptr;
+
+        out->view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        out->length = static_cast<std::size_t>(size.QuadPart);
+#else
+        auto file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file < 0)
+            return nullptr;
+
+        struct stat status{};
+        auto kept = ::fstat(file, &status) == 0 && status.st_size > 0;
+        auto view = kept ? ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0)
+                         : MAP_FAILED;
+        ::close(file);
+        if (view == MAP_FAILED)
+            return nullptr;
+
+        out->view   = view;
+        out->length = static_cast<std::size_t>(status.st_size);
+#endif
+        if (out->view == nullptr)
+            return nullptr;
+        return out;
+    }
+
+    auto static copy(std::span<std::byte const> bytes) -> std::unique_ptr<blob>
+    {
+        auto out    = std::unique_ptr<blob>{new blob{}};
+        out->memory = std::vector<std::byte>(bytes.begin(), bytes.end());
+        out->length = bytes.size();
+        return out;
+    }
+
+    auto bytes() const -> std::span<std::byte const>
+    {
+        auto const base = view != nullptr ? static_cast<std::byte const *>(view) : memory.data();
+        return {base, length};
+    }
+
+private:
+    blob() = default;
+
+    void *                 view{};
+    std::size_t            length{};
+    std::vector<std::byte> memory{};
+};
+
+// Tiles kept across runs, one file each in "directory", and the recently
+// used ones mapped in memory.
+//
+// Files are only opened when a tile is first asked for, so starting up costs
+// nothing. Both the files and the mapped tiles are bounded, and the least
+// recently used ones go first: the age of a file is its write time, which
+// every hit renews.
+//
+// Failing to read or write the directory never fails the caller: a broken
+// or foreign file is a miss, and a tile that can't be written stays in
+// memory only. All members may be called from any thread.
+class cache
+{
+public:
+    auto static constexpr disk_bytes   = std::size_t{1} << 30;
+    auto static constexpr memory_bytes = std::size_t{256} << 20;
+
+public:
+    explicit cache(
+        std::filesystem::path directory, std::size_t disk_budget = disk_bytes, std::size_t memory_budget = memory_bytes
+    )
+        : directory(std::move(directory))
+        , disk_budget(disk_budget)
+        , memory_budget(memory_budget)
+    {}
+
+    // The tile for "k", from memory or disk, or nothing.
+    auto find(key const & k) -> std::shared_ptr<blob const>
+    {
+        auto const lock = std::lock_guard{guard};
+        for (auto at = recent.begin(); at != recent.end(); ++at)
+        {
+            if (at->k != k)
+                continue;
+
+            recent.splice(recent.begin(), recent, at);
+            touch(k);
+            return at->tile;
+        }
+
+        auto const path = file(k);
+        auto       tile = std::shared_ptr<blob const>{blob::map(path)};
+        if (tile == nullptr)
+            return nullptr;
+
+        auto const payload = unwrap(k, tile->bytes());
+        if (payload.empty())
+        {
+            auto ignored = std::error_code{};
+            std::filesystem::remove(path, ignored);
+            return nullptr;
+        }
+
+        touch(k);
+        keep(k, tile);
+        return tile;
+    }
+
+    // Keep "payload" as the tile for "k", and return it as "find" would.
+    auto store(key const & k, std::span<std::byte const> payload) -> std::shared_ptr<blob const>
+    {
+        auto const lock  = std::lock_guard{guard};
+        auto       bytes = wrap(k, payload);
+        auto       tile  = std::shared_ptr<blob const>{};
+        if (write(k, bytes))
+            tile = blob::map(file(k));
+        if (tile == nullptr)
+            tile = blob::copy(bytes);
+
+        trim(k);
+        keep(k, tile);
+        return tile;
+    }
+
+    // The tile for "k" as "find" returns it, unless "is_valid" rejects its
+    // payload, else the payload "make" returns, stored. While one thread
+    // makes the tile of a key, others asking for the same key wait for it
+    // instead of making it again.
+    template <typename V, typename M>
+    auto obtain(key const & k, V const & is_valid, M const & make) -> std::shared_ptr<blob const>
+    {
+        struct claim
+        {
+            cache & owner;
+            key     k;
+
+            ~claim()
+            {
+                {
+                    auto const lock = std::lock_guard{owner.guard};
+                    std::erase(owner.making, k);
+                }
+                owner.made.notify_all();
+            }
+        };
+
+        {
+            auto lock = std::unique_lock{guard};
+            made.wait(lock, [&] { return std::find(making.begin(), making.end(), k) == making.end(); });
+            making.push_back(k);
+        }
+
+        auto const held = claim{*this, k};
+        auto       tile = find(k);
+        if (tile == nullptr || !is_valid(payload(*tile)))
+            tile = store(k, make());
+        return tile;
+    }
+
+    // The payload of a tile returned by "find" or "store".
+    auto static payload(blob const & tile) -> std::span<std::byte const>
+    {
+        return tile.bytes().subspan(sizeof(header));
+    }
+
+private:
+    // In front of every file, so that a file of another key, or a truncated
+    // one, is never used.
+    struct header
+    {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t length;
+        std::uint32_t filter;
+        std::uint64_t size; // of the payload
+        std::uint64_t reserved[4];
+    };
+
+    static_assert(sizeof(header) == 64); // payloads stay aligned to cache lines
+
+    auto static constexpr magic = std::uint32_t{0x4c49544b}; // "KTIL"
+
+    auto static wrap(key const & k, std::span<std::byte const> payload) -> std::vector<std::byte>
+    {
+        auto const filter = static_cast<std::uint32_t>(k.filter);
+        auto const head   = header{magic, k.version, k.width, k.height, k.length, filter, payload.size(), {}};
+        auto       out    = std::vector<std::byte>(sizeof(header) + payload.size());
+        std::memcpy(out.data(), &head, sizeof(header));
+        std::copy(payload.begin(), payload.end(), out.begin() + sizeof(header));
+        return out;
+    }
+
+    // The payload, empty if the bytes aren't a tile for "k".
+    auto static unwrap(key const & k, std::span<std::byte const> bytes) -> std::span<std::byte const>
+    {
+        auto head = header{};
+        if (bytes.size() < sizeof(header))
+            return {};
+
+        std::memcpy(&head, bytes.data(), sizeof(header));
+        auto const is_match = head.magic == magic && head.version == k.version && head.width == k.width
+                           && head.height == k.height && head.length == k.length
+                           && head.filter == static_cast<std::uint32_t>(k.filter)
+                           && head.size == bytes.size() - sizeof(header);
+        return is_match ? bytes.subspan(sizeof(header)) : std::span<std::byte const>{};
+    }
+
+    auto file(key const & k) const -> std::filesystem::path
+    {
+        auto const filter = k.filter == sample::filter::point ? "point" : "linear";
+        auto const size   = std::to_string(k.width) + "x" + std::to_string(k.height);
+        auto const length = std::to_string(k.length);
+        return directory / ("fold-" + size + "-" + length + "-" + filter + "-v" + std::to_string(k.version) + ".tile");
+    }
+
+    // Written next to the file and renamed, so that no reader sees half of it.
+    auto write(key const & k, std::span<std::byte const> bytes) const -> bool
+    {
+        auto ignored = std::error_code{};
+        std::filesystem::create_directories(directory, ignored);
+
+        auto const path = file(k);
+        auto       temp = path;
+        temp += ".part";
+        {
+            auto out = std::ofstream(temp, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<char const *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+            if (!out)
+            {
+                out.close();
+                std::filesystem::remove(temp, ignored);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temp, path, ignored);
+        return !ignored;
+    }
+
+    auto touch(key const & k) const -> void
+    {
+        auto ignored = std::error_code{};
+        std::filesystem::last_write_time(file(k), std::filesystem::file_time_type::clock::now(), ignored);
+    }
+
+    // Remove the oldest files until the directory fits its budget, except
+    // the one of "k".
+    auto trim(key const & k) const -> void
+    {
+        struct stored
+        {
+            std::filesystem::path           path;
+            std::uintmax_t                  size;
+            std::filesystem::file_time_type time;
+        };
+
+        auto ignored = std::error_code{};
+        auto items   = std::vector<stored>{};
+        auto total   = std::uintmax_t{};
+        auto keep    = file(k);
+        for (auto const & entry : std::filesystem::directory_iterator(directory, ignored))
+        {
+            if (entry.path().extension() != ".tile")
+                continue;
+
+            auto size = entry.file_size(ignored);
+            auto time = entry.last_write_time(ignored);
+            if (ignored)
+                continue;
+
+            total += size;
+            if (entry.path() != keep)
+                items.push_back({entry.path(), size, time});
+        }
+
+        std::sort(items.begin(), items.end(), [](stored const & a, stored const & b) { return a.time < b.time; });
+        for (auto const & old : items)
+        {
+            if (total <= disk_budget)
+                break;
+            if (std::filesystem::remove(old.path, ignored))
+                total -= old.size;
+        }
+    }
+
+    // Put "tile" in front of the mapped ones and drop the oldest beyond the
+    // budget. Tiles still held by a caller stay valid until released.
+    auto keep(key const & k, std::shared_ptr<blob const> const & tile) -> void
+    {
+        recent.remove_if([&](item const & i) { return i.k == k; });
+        recent.push_front({k, tile});
+
+        auto total = std::size_t{};
+        for (auto at = recent.begin(); at != recent.end();)
+        {
+            auto const size = at->tile->bytes().size();
+            if (total + size > memory_budget && at != recent.begin())
+            {
+                at = recent.erase(at);
+                continue;
+            }
+
+            total += size;
+            ++at;
+        }
+    }
+
+private:
+    struct item
+    {
+        key                         k;
+        std::shared_ptr<blob const> tile;
+    };
+
+    std::filesystem::path directory;
+    std::size_t           disk_budget;
+    std::size_t           memory_budget;
+    std::mutex              guard{};
+    std::condition_variable made{};
+    std::list<item>         recent{}; // most recently used first
+    std::vector<key>        making{}; // by a thread in "obtain"
+};
+} // namespace tiles
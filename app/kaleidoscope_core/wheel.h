@@ -0,0 +1,172 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace wheel
+{
+
+using clock = std::chrono::steady_clock;
+
+// Notches closer than this belong to one zoom.
+auto inline constexpr threshold = std::chrono::milliseconds{333};
+
+// Pixels a notch adds to the side length, once a zoom has gone on for longer
+// than the time next to it.
+auto inline constexpr acceleration = std::array<std::pair<std::chrono::milliseconds, int>, 6>{{
+    {std::chrono::milliseconds{1600}, 13},
+    {std::chrono::milliseconds{1000}, 8},
+    {std::chrono::milliseconds{600}, 5},
+    {std::chrono::milliseconds{400}, 3},
+    {std::chrono::milliseconds{200}, 2},
+    {std::chrono::milliseconds{0}, 1},
+}};
+
+// The pixels per notch after a zoom has gone on for "held".
+auto inline constexpr step(clock::duration held) -> int
+{
+    for (auto && [after, factor] : acceleration)
+        if (held > after)
+            return factor;
+    return acceleration.back().second;
+}
+
+// Prepares the side lengths a zoom is about to reach, on a thread of its own.
+//
+// Fed the same notches as "viewmodel::state::on_length_changed", it follows
+// the zoom the same way: when it began and how far apart its notches come.
+// From that it predicts the lengths of the next "notches" notches, each one
+// "step" further than the last, and calls "prepare" for each, nearest first.
+// A new notch replaces the predictions not yet started, so the thread never
+// lags behind a zoom that turned around or stopped.
+//
+// "prepare" must be safe to run next to the renderer, e.g.
+// "engine::fold_map::prepare" with the cache of the renderer's fold_map.
+class prebuilder
+{
+public:
+    using prepare_type = std::function<void(std::uint32_t)>;
+
+    auto static constexpr lookahead = 4u;
+    auto static constexpr shortest  = 8u; // see "model::scoped_triangle::zoom_to"
+
+    // Until the second notch of a zoom tells how fast it goes.
+    auto static constexpr interval = std::chrono::milliseconds{50};
+
+public:
+    explicit prebuilder(prepare_type prepare, std::uint32_t notches = lookahead)
+        : prepare(std::move(prepare))
+        , notches(notches)
+        , worker([this](std::stop_token token) { serve(token); })
+    {}
+
+    ~prebuilder()
+    {
+        worker.request_stop();
+        {
+            auto guard = std::lock_guard{lock};
+            pending.clear();
+        }
+        wakeup.notify_all();
+    }
+
+    prebuilder(prebuilder const &)             = delete;
+    prebuilder & operator=(prebuilder const &) = delete;
+
+    // A notch of "delta" left the side length at "length", and "longest" is
+    // the longest the triangle fits at its position.
+    auto on_zoom(int delta, std::uint32_t length, std::uint32_t longest, clock::time_point now = clock::now()) -> void
+    {
+        if (delta == 0)
+            return;
+
+        if (now - previous > threshold)
+        {
+            beginning = now;
+            count     = 0;
+        }
+        previous = now;
+        ++count;
+
+        auto const gap  = count > 1 ? (now - beginning) / (count - 1) : clock::duration{interval};
+        auto const most = std::max<std::int64_t>(shortest, longest);
+        auto       next = std::vector<std::uint32_t>{};
+        auto       at   = static_cast<std::int64_t>(length);
+        for (auto i = 1u; i <= notches; ++i)
+        {
+            auto const held = now - beginning + gap * i;
+            auto const to   = std::clamp<std::int64_t>(at + std::int64_t{delta} * step(held), shortest, most);
+            if (to == at)
+                break;
+
+            at = to;
+            next.push_back(static_cast<std::uint32_t>(at));
+        }
+
+        {
+            auto guard = std::lock_guard{lock};
+            pending    = std::move(next);
+        }
+        wakeup.notify_one();
+    }
+
+    // Wait until every prediction so far is prepared.
+    auto wait() -> void
+    {
+        auto guard = std::unique_lock{lock};
+        finished.wait(guard, [this] { return pending.empty() && !is_busy; });
+    }
+
+private:
+    auto serve(std::stop_token token) -> void
+    {
+        while (true)
+        {
+            auto length = std::uint32_t{};
+            {
+                auto guard = std::unique_lock{lock};
+                wakeup.wait(guard, [&] { return !pending.empty() || token.stop_requested(); });
+                if (token.stop_requested())
+                    return;
+
+                length = pending.front();
+                pending.erase(pending.begin());
+                is_busy = true;
+            }
+
+            prepare(length);
+
+            {
+                auto guard = std::lock_guard{lock};
+                is_busy    = false;
+            }
+            finished.notify_all();
+        }
+    }
+
+private:
+    // Inputs
+    prepare_type      prepare;
+    std::uint32_t     notches;
+    clock::time_point beginning{};
+    clock::time_point previous{};
+    std::uint32_t     count{}; // notches since "beginning"
+
+    // Lengths still to prepare, nearest first
+    std::vector<std::uint32_t> pending{};
+    bool                       is_busy{};
+    std::mutex                 lock{};
+    std::condition_variable    wakeup{};
+    std::condition_variable    finished{};
+
+    // Last, so that it stops before the members it uses are destroyed
+    std::jthread worker;
+};
+} // namespace wheel
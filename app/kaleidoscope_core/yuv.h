@@ -0,0 +1,316 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "image.h"
+#include "simd.h"
+
+// Frames in the YUV 4:2:0 formats that video encoders take, and the
+// conversion from the BGRA frames of the capture.
+//
+// Colors are BT.709 in limited range, as DXGI_FORMAT_NV12 is by default,
+// with 8 bits of precision per coefficient. Chroma is sited at the center
+// of each 2 x 2 block of pixels: the average of its 4 pixels, and where the
+// fold samples a chroma plane at half the size, see "engine::planar".
+
+namespace yuv
+{
+
+enum class format
+{
+    nv12, // a plane of Y, then one of U and V interleaved
+    i420, // planes of Y, U and V
+};
+
+// Black, and the value of every tap outside the source.
+auto inline constexpr black_luma   = std::uint8_t{16};
+auto inline constexpr black_chroma = std::uint16_t{0x8080}; // U and V, as NV12 stores them
+
+// Non-owning view of a frame in either format. "width" and "height" are
+// those of the luma plane, chroma has half of both, rounded up. Strides are
+// in bytes. A row of chroma holds a U and a V every "step" bytes: 2 in NV12,
+// where "v" is "u + 1", 1 in I420.
+template <typename T> struct basic_view
+{
+    std::uint32_t width{};
+    std::uint32_t height{};
+    T *           y{};
+    std::size_t   y_stride{};
+    T *           u{};
+    T *           v{};
+    std::size_t   uv_stride{};
+    std::uint32_t step{1};
+
+    basic_view() = default;
+
+    basic_view(
+        std::uint32_t width, std::uint32_t height, T * y, std::size_t y_stride, T * u, T * v, std::size_t uv_stride,
+        std::uint32_t step
+    )
+        : width(width)
+        , height(height)
+        , y(y)
+        , y_stride(y_stride)
+        , u(u)
+        , v(v)
+        , uv_stride(uv_stride)
+        , step(step)
+    {}
+
+    template <typename U>
+        requires std::is_convertible_v<U *, T *>
+    basic_view(basic_view<U> const & other)
+        : basic_view(
+              other.width, other.height, other.y, other.y_stride, other.u, other.v, other.uv_stride, other.step
+          )
+    {}
+
+    auto chroma_width() const -> std::uint32_t
+    {
+        return (width + 1) / 2;
+    }
+
+    auto chroma_height() const -> std::uint32_t
+    {
+        return (height + 1) / 2;
+    }
+
+    auto luma() const -> image::basic_view<T>
+    {
+        return {y, width, height, y_stride};
+    }
+
+    // Whether chroma rows are U and V pairs, one 16-bit word per texel.
+    auto is_interleaved() const -> bool
+    {
+        return step == 2 && v == u + 1;
+    }
+};
+
+using view       = basic_view<std::uint8_t>;
+using const_view = basic_view<std::uint8_t const>;
+
+// Owning frame, black until written. Rows of every plane start on a cache
+// line.
+class frame
+{
+public:
+    frame() = default;
+
+    frame(format layout, std::uint32_t width, std::uint32_t height)
+    {
+        resize(layout, width, height);
+    }
+
+    auto resize(format layout, std::uint32_t width, std::uint32_t height) -> void
+    {
+        auto constexpr line = image::cache_line;
+        auto const     half = (std::size_t{width} + 1) / 2;
+        how                 = layout;
+        w                   = width;
+        h                   = height;
+        y_stride            = (std::size_t{width} + line - 1) / line * line;
+        uv_stride           = ((layout == format::nv12 ? 2 * half : half) + line - 1) / line * line;
+
+        auto const planes = layout == format::nv12 ? 1u : 2u;
+        luma_size         = y_stride * h;
+        chroma_size       = uv_stride * ((h + 1) / 2);
+        bytes.resize(luma_size + planes * chroma_size);
+        std::memset(bytes.data(), black_luma, luma_size);
+        std::memset(bytes.data() + luma_size, 0x80, planes * chroma_size);
+    }
+
+    auto layout() const -> format
+    {
+        return how;
+    }
+
+    auto view() const -> yuv::view
+    {
+        auto const chroma = bytes.data() + luma_size;
+        if (how == format::nv12)
+            return {w, h, bytes.data(), y_stride, chroma, chroma + 1, uv_stride, 2};
+        return {w, h, bytes.data(), y_stride, chroma, chroma + chroma_size, uv_stride, 1};
+    }
+
+    auto const_view() const -> yuv::const_view
+    {
+        return view();
+    }
+
+    // Bytes of all planes, padding included.
+    auto size() const -> std::size_t
+    {
+        return bytes.size();
+    }
+
+private:
+    image::buffer<std::uint8_t> bytes{};
+    format                      how{};
+    std::uint32_t               w{};
+    std::uint32_t               h{};
+    std::size_t                 y_stride{};
+    std::size_t                 uv_stride{};
+    std::size_t                 luma_size{};
+    std::size_t                 chroma_size{}; // of one plane
+};
+
+// Y of one pixel.
+auto inline constexpr luma(image::pixel p) -> std::uint8_t
+{
+    auto const b = static_cast<std::int32_t>(p & 0xff);
+    auto const g = static_cast<std::int32_t>((p >> 8) & 0xff);
+    auto const r = static_cast<std::int32_t>((p >> 16) & 0xff);
+    return static_cast<std::uint8_t>((16 * b + 157 * g + 47 * r + 128 + (16 << 8)) >> 8);
+}
+
+// U and V of the sums of each channel of 4 pixels, U in the low byte.
+auto inline constexpr chroma(std::int32_t b, std::int32_t g, std::int32_t r) -> std::uint16_t
+{
+    auto const u = (112 * b - 86 * g - 26 * r + 512 + (128 << 10)) >> 10;
+    auto const v = (-10 * b - 102 * g + 112 * r + 512 + (128 << 10)) >> 10;
+    return static_cast<std::uint16_t>(u | v << 8);
+}
+
+// Of the 2 x 2 pixels "a" and "b" of the row "r0", "c" and "d" below them.
+auto inline constexpr chroma(image::pixel a, image::pixel b, image::pixel c, image::pixel d) -> std::uint16_t
+{
+    auto const sum = [&](std::uint32_t shift)
+    {
+        return static_cast<std::int32_t>(
+            ((a >> shift) & 0xff) + ((b >> shift) & 0xff) + ((c >> shift) & 0xff) + ((d >> shift) & 0xff)
+        );
+    };
+    return chroma(sum(0), sum(8), sum(16));
+}
+
+// Y of "count" pixels.
+auto inline luma_row(image::pixel const * from, std::uint8_t * out, std::uint32_t count) -> void
+{
+    auto x = 0u;
+#ifdef KALEIDOSCOPE_SSE2
+    // 16 pixels per iteration: the channels of 2 pixels per multiply-add,
+    // then the halves of each pixel added up
+    auto const zero   = _mm_setzero_si128();
+    auto const weight = _mm_setr_epi16(16, 157, 47, 0, 16, 157, 47, 0);
+    auto const bias   = _mm_set1_epi32(128 + (16 << 8));
+    auto const four   = [&](image::pixel const * p)
+    {
+        auto const v  = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+        auto const lo = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weight));
+        auto const hi = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weight));
+        auto const bg = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+        auto const ra = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+        return _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(bg, ra), bias), 8);
+    };
+    for (; x + 16 <= count; x += 16)
+    {
+        auto const low  = _mm_packs_epi32(four(from + x), four(from + x + 4));
+        auto const high = _mm_packs_epi32(four(from + x + 8), four(from + x + 12));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), _mm_packus_epi16(low, high));
+    }
+#endif
+    for (; x < count; ++x)
+        out[x] = luma(from[x]);
+}
+
+// U and V of "count" texels, each from 2 pixels of the rows "r0" and "r1".
+auto inline chroma_row(image::pixel const * r0, image::pixel const * r1, std::uint16_t * out, std::uint32_t count)
+    -> void
+{
+    auto x = 0u;
+#ifdef KALEIDOSCOPE_SSE2
+    // 4 texels per iteration: the channels summed as in "previews::halve",
+    // then both weighted as in "luma_row"
+    auto const zero = _mm_setzero_si128();
+    auto const to_u = _mm_setr_epi16(112, -86, -26, 0, 112, -86, -26, 0);
+    auto const to_v = _mm_setr_epi16(-10, -102, 112, 0, -10, -102, 112, 0);
+    auto const bias = _mm_set1_epi32(512 + (128 << 10));
+    auto const load = [](image::pixel const * p) { return _mm_loadu_si128(reinterpret_cast<__m128i const *>(p)); };
+    auto const mix  = [&](__m128i p0, __m128i p1, __m128i weight)
+    {
+        auto const lo = _mm_castsi128_ps(_mm_madd_epi16(p0, weight));
+        auto const hi = _mm_castsi128_ps(_mm_madd_epi16(p1, weight));
+        auto const bg = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+        auto const ra = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+        return _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(bg, ra), bias), 10);
+    };
+    for (; x + 4 <= count; x += 4)
+    {
+        auto const a0 = load(r0 + 2 * x);
+        auto const a1 = load(r0 + 2 * x + 4);
+        auto const b0 = load(r1 + 2 * x);
+        auto const b1 = load(r1 + 2 * x + 4);
+        auto const s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+        auto const s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+        auto const s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+        auto const s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+        auto const p0 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+        auto const p1 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+
+        // [u0 u1 u2 u3 v0 v1 v2 v3] -> u0 v0 u1 v1 u2 v2 u3 v3
+        auto const uv = _mm_packus_epi16(_mm_packs_epi32(mix(p0, p1, to_u), mix(p0, p1, to_v)), zero);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + x), _mm_unpacklo_epi8(uv, _mm_srli_si128(uv, 4)));
+    }
+#endif
+    for (; x < count; ++x)
+        out[x] = chroma(r0[2 * x], r0[2 * x + 1], r1[2 * x], r1[2 * x + 1]);
+}
+
+// "count" texels of chroma row "cy" from column "cx" on, from U and V pairs.
+auto inline store_chroma(
+    view target, std::uint32_t cx, std::uint32_t cy, std::uint16_t const * pairs, std::uint32_t count
+) -> void
+{
+    auto const at = std::size_t{cy} * target.uv_stride + std::size_t{cx} * target.step;
+    if (target.is_interleaved())
+    {
+        std::memcpy(target.u + at, pairs, count * sizeof(std::uint16_t));
+        return;
+    }
+
+    auto const u = target.u + at;
+    auto const v = target.v + at;
+    for (auto i = 0u; i < count; ++i)
+    {
+        u[i * target.step] = static_cast<std::uint8_t>(pairs[i]);
+        v[i * target.step] = static_cast<std::uint8_t>(pairs[i] >> 8);
+    }
+}
+
+// Rows "top" to "bottom" of "source" into "target" of the same size, and
+// the rows of chroma they cover. Bands of rows may be converted in
+// parallel as long as they start on even rows.
+auto inline convert(image::const_view source, view target, std::uint32_t top, std::uint32_t bottom) -> void
+{
+    bottom = std::min(bottom, source.height);
+    for (auto y = top; y < bottom; ++y)
+        luma_row(source.row(y), target.y + std::size_t{y} * target.y_stride, source.width);
+
+    // An odd last column or row counts its pixels twice
+    auto constexpr chunk = 256u;
+    auto           pairs = std::array<std::uint16_t, chunk>{};
+    auto const     whole = source.width / 2;
+    for (auto cy = top / 2; cy < (bottom + 1) / 2; ++cy)
+    {
+        auto const r0 = source.row(2 * cy);
+        auto const r1 = source.row(std::min(2 * cy + 1, source.height - 1));
+        for (auto cx = 0u; cx < whole; cx += chunk)
+        {
+            auto const count = std::min(chunk, whole - cx);
+            chroma_row(r0 + 2 * cx, r1 + 2 * cx, pairs.data(), count);
+            store_chroma(target, cx, cy, pairs.data(), count);
+        }
+        if (whole != target.chroma_width())
+        {
+            auto const last = source.width - 1;
+            pairs[0]        = chroma(r0[last], r0[last], r1[last], r1[last]);
+            store_chroma(target, whole, cy, pairs.data(), 1);
+        }
+    }
+}
+} // namespace yuv